@@ -0,0 +1,137 @@
+// counts heap allocations per message of a steady state N/M/R/X flow through OrderBookManager. make
+// allocbench-baseline builds the same flow with the node pools compiled out (OB_DISABLE_POOLS) to compare with
+#include "orderbookmanager.h"
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace
+{
+    uint64_t allocations = 0;
+    uint64_t allocatedBytes = 0;
+
+    // small deterministic generator so that every run replays the same flow
+    struct Lcg
+    {
+        uint64_t state_;
+        explicit Lcg(uint64_t seed) :state_(seed) {}
+        uint32_t next() { state_ = state_ * 6364136223846793005ULL + 1442695040888963407ULL; return static_cast<uint32_t>(state_ >> 33); }
+        int range(int lo, int hi) { return lo + static_cast<int>(next() % static_cast<uint32_t>(hi - lo + 1)); }
+    };
+
+    const int PRODUCTS = 4;
+    const int LIVE_ORDERS = 10000;
+    const int PRICE_SCALE = 10000; // default fixed point scale of the manager
+
+    struct Flow
+    {
+        OrderBookManager& manager_;
+        Lcg rng_;
+        std::vector<int> live_;
+        std::vector<int> liveProduct_;
+        int nextId_ = 1;
+
+        Flow(OrderBookManager& manager, uint64_t seed) :manager_(manager), rng_(seed)
+        {
+            live_.reserve(LIVE_ORDERS * 2);
+            liveProduct_.reserve(LIVE_ORDERS * 2);
+        }
+
+        void dropLive(size_t idx)
+        {
+            live_[idx] = live_.back();
+            live_.pop_back();
+        }
+
+        // one message. bids rest on 90..99, offers on 101..110 and trades cross at 100
+        int step()
+        {
+            const int dice = rng_.range(0, 99);
+            const int productId = rng_.range(1, PRODUCTS);
+
+            if (dice < 4)
+            {
+                // crossing pair fully consumed by the trade that follows
+                const int qty = rng_.range(1, 100);
+                manager_.action(ACTION::NEW, productId, nextId_++, SIDE::SELL, qty, 100 * PRICE_SCALE);
+                manager_.action(ACTION::NEW, productId, nextId_++, SIDE::BUY, qty, 100 * PRICE_SCALE);
+                manager_.action(ACTION::TRADE, productId, 0, 0, qty, 100 * PRICE_SCALE);
+                return 3;
+            }
+
+            if (live_.empty() || (dice < 55 && live_.size() < LIVE_ORDERS))
+            {
+                const char side = (rng_.next() & 1) ? SIDE::BUY : SIDE::SELL;
+                const int tick = rng_.range(1, 10);
+                const Price price = (side == SIDE::BUY ? 100 - tick : 100 + tick) * PRICE_SCALE;
+                manager_.action(ACTION::NEW, productId, nextId_, side, rng_.range(1, 100), price);
+                live_.push_back(nextId_++);
+                return 1;
+            }
+
+            const size_t idx = rng_.next() % live_.size();
+            if (dice < 75)
+            {
+                manager_.action(ACTION::MODIFY, 0, live_[idx], SIDE::BUY, rng_.range(1, 100), PRICE_SCALE);
+            }
+            else
+            {
+                manager_.action(ACTION::REMOVE, 0, live_[idx], SIDE::BUY, 1, PRICE_SCALE);
+                dropLive(idx);
+            }
+            return 1;
+        }
+    };
+}
+
+void* operator new(std::size_t size)
+{
+    ++allocations;
+    allocatedBytes += size;
+    if (void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+int main(int argc, char* argv[])
+{
+    const int messages = (argc > 1) ? std::atoi(argv[1]) : 1000000;
+
+    OrderBookManager manager;
+    Flow flow(manager, 42);
+
+    // warm up till the books reach their steady state depth
+    int warmup = 0;
+    while (warmup < messages / 5)
+        warmup += flow.step();
+
+    const uint64_t allocationsBefore = allocations;
+    const uint64_t bytesBefore = allocatedBytes;
+
+    int processed = 0;
+    while (processed < messages)
+        processed += flow.step();
+
+    const uint64_t count = allocations - allocationsBefore;
+    const uint64_t bytes = allocatedBytes - bytesBefore;
+
+#ifdef OB_DISABLE_POOLS
+    std::cout << "node pools [off]" << std::endl;
+#else
+    std::cout << "node pools [on]" << std::endl;
+#endif
+    std::cout << "messages [" << processed << "] allocations [" << count << "] bytes [" << bytes << "]" << std::endl;
+    std::cout << "allocations/message [" << static_cast<double>(count) / processed << "] bytes/message [" << static_cast<double>(bytes) / processed << "]" << std::endl;
+    manager.printExceptions();
+}
@@ -0,0 +1,440 @@
+// microbenchmarks of the book operations over synthetic books of varying depth, orders per level and cancel ratio
+#include "orderbookmanager.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // small deterministic generator so that every run measures the same workload
+    struct Lcg
+    {
+        uint64_t state_;
+        explicit Lcg(uint64_t seed) :state_(seed) {}
+        uint32_t next() { state_ = state_ * 6364136223846793005ULL + 1442695040888963407ULL; return static_cast<uint32_t>(state_ >> 33); }
+        int range(int lo, int hi) { return lo + static_cast<int>(next() % static_cast<uint32_t>(hi - lo + 1)); }
+    };
+
+    // hardware branch mispredictions of the calling thread through perf_event_open. where the kernel or the
+    // container does not allow it the counter stays closed and the benchmarks just report no branchMisses
+    class BranchMisses
+    {
+    private:
+        int fd_ = -1;
+
+#ifdef __linux__
+        void control(unsigned long request) { if (fd_ >= 0) ioctl(fd_, request, 0); }
+#else
+        void control(unsigned long) {}
+#endif
+
+    public:
+        BranchMisses()
+        {
+#ifdef __linux__
+            perf_event_attr attr{};
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+        }
+
+        ~BranchMisses()
+        {
+#ifdef __linux__
+            if (fd_ >= 0)
+                close(fd_);
+#endif
+        }
+
+#ifdef __linux__
+        void start() { control(PERF_EVENT_IOC_RESET); control(PERF_EVENT_IOC_ENABLE); }
+        void pause() { control(PERF_EVENT_IOC_DISABLE); }
+        void resume() { control(PERF_EVENT_IOC_ENABLE); }
+#else
+        void start() {}
+        void pause() {}
+        void resume() {}
+#endif
+
+        // mispredictions per iteration as a counter of the benchmark, nothing when unavailable
+        void report(benchmark::State& state)
+        {
+            pause();
+            uint64_t misses = 0;
+#ifdef __linux__
+            if (fd_ < 0 || read(fd_, &misses, sizeof(misses)) != static_cast<ssize_t>(sizeof(misses)))
+                return;
+#else
+            return;
+#endif
+            state.counters["branchMisses"] = benchmark::Counter(static_cast<double>(misses), benchmark::Counter::kAvgIterations);
+        }
+    };
+
+    const Price TICK = 100; // 0.01 at the default scale
+    const Price MID = 100 * 10000;
+    const int MAX_LEVELS = 2000;
+    const int BATCH = 1024; // operations between two untimed resets of the book
+
+    // ladder books carry a band wide enough for every level the benchmarks open
+    ProductConfig bookConfig(bool ladder)
+    {
+        ProductConfig config;
+        if (ladder)
+        {
+            config.band_.tickSize_ = TICK;
+            config.band_.minPrice_ = MID - MAX_LEVELS * TICK;
+            config.band_.maxPrice_ = MID + MAX_LEVELS * TICK;
+        }
+        return config;
+    }
+
+    Price levelPrice(char side, int level) { return (side == SIDE::BUY) ? MID - (level + 1) * TICK : MID + (level + 1) * TICK; }
+
+    // both sides of a book with levels price levels of ordersPerLevel orders each. ids run from 1, bids first
+    struct SyntheticBook
+    {
+        OrderBook book_;
+        const int levels_;
+        const int ordersPerLevel_;
+        int nextId_ = 1;
+
+        SyntheticBook(int levels, int ordersPerLevel, bool ladder) :book_(1, bookConfig(ladder)), levels_(levels), ordersPerLevel_(ordersPerLevel)
+        {
+            for (char side : { SIDE::BUY, SIDE::SELL })
+            {
+                for (int level = 0; level < levels; ++level)
+                {
+                    for (int idx = 0; idx < ordersPerLevel; ++idx)
+                        book_.enterOrder(nextId_++, side, levelPrice(side, level), 100);
+                }
+            }
+        }
+
+        int restingOrders() const { return 2 * levels_ * ordersPerLevel_; }
+    };
+
+    void bookArgs(benchmark::internal::Benchmark* bench)
+    {
+        bench->ArgNames({ "levels", "perLevel", "ladder" });
+        bench->ArgsProduct({ { 1, 10, 100, 1000 }, { 1, 10 }, { 0, 1 } });
+    }
+
+    // new orders joining random existing levels. the batch is cancelled untimed to keep the depth steady
+    void BM_EnterOrder(benchmark::State& state)
+    {
+        SyntheticBook fixture(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)), state.range(2) != 0);
+        Lcg rng(1);
+        const int firstId = fixture.nextId_;
+        int id = firstId;
+
+        BranchMisses branchMisses;
+        branchMisses.start();
+        for (auto _ : state)
+        {
+            const char side = (rng.next() & 1) ? SIDE::BUY : SIDE::SELL;
+            benchmark::DoNotOptimize(fixture.book_.enterOrder(id++, side, levelPrice(side, rng.range(0, fixture.levels_ - 1)), 100));
+
+            if (id - firstId == BATCH)
+            {
+                state.PauseTiming();
+                branchMisses.pause();
+                while (id > firstId)
+                    fixture.book_.deleteOrder(--id);
+                branchMisses.resume();
+                state.ResumeTiming();
+            }
+        }
+        branchMisses.report(state);
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_EnterOrder)->Apply(bookArgs);
+
+    // quantity changes of random resting orders
+    void BM_ModifyOrder(benchmark::State& state)
+    {
+        SyntheticBook fixture(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)), state.range(2) != 0);
+        Lcg rng(2);
+
+        BranchMisses branchMisses;
+        branchMisses.start();
+        for (auto _ : state)
+            benchmark::DoNotOptimize(fixture.book_.modifyOrder(rng.range(1, fixture.restingOrders()), rng.range(1, 100)));
+
+        branchMisses.report(state);
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_ModifyOrder)->Apply(bookArgs);
+
+    // cancels of random resting orders. every batch is drawn and, once cancelled, entered again untimed
+    void BM_DeleteOrder(benchmark::State& state)
+    {
+        SyntheticBook fixture(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)), state.range(2) != 0);
+        Lcg rng(3);
+
+        std::vector<int> ids;
+        for (int id = 1; id < fixture.nextId_; ++id)
+            ids.push_back(id);
+        const size_t batchSize = std::min<size_t>(BATCH, ids.size());
+
+        std::vector<RestingOrder> batch;
+        batch.reserve(batchSize);
+        size_t next = 0;
+
+        BranchMisses branchMisses;
+        branchMisses.start();
+        for (auto _ : state)
+        {
+            if (next == batch.size())
+            {
+                state.PauseTiming();
+                branchMisses.pause();
+                for (const RestingOrder& order : batch)
+                    fixture.book_.enterOrder(order.id_, order.side_, order.price_, order.quantity_);
+                batch.clear();
+
+                // distinct ids, the head of a partial shuffle
+                for (size_t idx = 0; idx < batchSize; ++idx)
+                {
+                    std::swap(ids[idx], ids[idx + rng.next() % (ids.size() - idx)]);
+                    RestingOrder order{};
+                    fixture.book_.getOrderFromId(ids[idx], order);
+                    batch.push_back(order);
+                }
+                next = 0;
+                branchMisses.resume();
+                state.ResumeTiming();
+            }
+
+            benchmark::DoNotOptimize(fixture.book_.deleteOrder(batch[next++].id_));
+        }
+        branchMisses.report(state);
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_DeleteOrder)->Apply(bookArgs);
+
+    // an X trade sweeping the best swept levels of the offers against one crossing bid, the book a
+    // replica would hold just before the trade is reported. the same book is refilled untimed after every
+    // trade, and a level behind the swept ones on each side keeps both sides from emptying
+    void BM_HandleTrade(benchmark::State& state)
+    {
+        const int swept = static_cast<int>(state.range(0));
+        const int ordersPerLevel = static_cast<int>(state.range(1));
+        const bool ladder = state.range(2) != 0;
+        const int quantity = swept * ordersPerLevel * 100;
+
+        OrderBook book(1, bookConfig(ladder));
+        int id = 1;
+        book.enterOrder(id++, SIDE::SELL, levelPrice(SIDE::SELL, swept + 10), 100);
+        book.enterOrder(id++, SIDE::BUY, levelPrice(SIDE::BUY, 10), 100);
+        const int firstId = id;
+
+        Result result = Result::OK;
+        BranchMisses branchMisses;
+        branchMisses.start();
+        for (auto _ : state)
+        {
+            state.PauseTiming();
+            branchMisses.pause();
+            id = firstId;
+            for (int level = 0; level < swept; ++level)
+            {
+                for (int idx = 0; idx < ordersPerLevel; ++idx)
+                    book.enterOrder(id++, SIDE::SELL, levelPrice(SIDE::SELL, level), 100);
+            }
+            book.enterOrder(id, SIDE::BUY, levelPrice(SIDE::SELL, swept - 1), quantity);
+            branchMisses.resume();
+            state.ResumeTiming();
+
+            result = book.handleTrade(levelPrice(SIDE::SELL, swept - 1), quantity);
+            if (result != Result::OK)
+                break;
+        }
+        if (result != Result::OK)
+            state.SkipWithError("trade rejected");
+        branchMisses.report(state);
+        state.SetItemsProcessed(state.iterations());
+        state.counters["fills"] = benchmark::Counter(static_cast<double>(state.iterations()) * swept * ordersPerLevel, benchmark::Counter::kIsRate);
+    }
+    BENCHMARK(BM_HandleTrade)->ArgNames({ "swept", "perLevel", "ladder" })->ArgsProduct({ { 1, 5, 20, 100 }, { 1, 10 }, { 0, 1 } });
+
+    // steady flow over a book of fixed depth. cancelPct of the messages cancel an order and enter a
+    // replacement, the others modify one
+    void BM_MixedFlow(benchmark::State& state)
+    {
+        SyntheticBook fixture(static_cast<int>(state.range(0)), 10, false);
+        const int cancelPct = static_cast<int>(state.range(1));
+        Lcg rng(4);
+
+        std::vector<int> live;
+        live.reserve(fixture.restingOrders());
+        for (int id = 1; id < fixture.nextId_; ++id)
+            live.push_back(id);
+
+        int64_t messages = 0;
+        BranchMisses branchMisses;
+        branchMisses.start();
+        for (auto _ : state)
+        {
+            const size_t idx = rng.next() % live.size();
+            if (rng.range(0, 99) < cancelPct)
+            {
+                fixture.book_.deleteOrder(live[idx]);
+                const char side = (rng.next() & 1) ? SIDE::BUY : SIDE::SELL;
+                fixture.book_.enterOrder(fixture.nextId_, side, levelPrice(side, rng.range(0, fixture.levels_ - 1)), rng.range(1, 100));
+                live[idx] = fixture.nextId_++;
+                messages += 2;
+            }
+            else
+            {
+                fixture.book_.modifyOrder(live[idx], rng.range(1, 100));
+                ++messages;
+            }
+        }
+        branchMisses.report(state);
+        state.SetItemsProcessed(messages);
+    }
+    BENCHMARK(BM_MixedFlow)->ArgNames({ "levels", "cancelPct" })->ArgsProduct({ { 10, 100, 1000 }, { 0, 25, 50, 90 } });
+
+    // lookups of random live ids
+    void BM_GetOrderFromId(benchmark::State& state)
+    {
+        SyntheticBook fixture(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)), false);
+        Lcg rng(5);
+        RestingOrder order{};
+
+        for (auto _ : state)
+            benchmark::DoNotOptimize(fixture.book_.getOrderFromId(rng.range(1, fixture.restingOrders()), order));
+
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_GetOrderFromId)->ArgNames({ "levels", "perLevel" })->ArgsProduct({ { 10, 1000 }, { 1, 10, 100 } });
+
+    // resting orders in shuffled price order, as a start of day file would list them. levels price levels a side
+    std::vector<RestingOrder> restingOrders(int levels, int ordersPerLevel)
+    {
+        std::vector<RestingOrder> orders;
+        int id = 1;
+        for (char side : { SIDE::BUY, SIDE::SELL })
+        {
+            for (int level = 0; level < levels; ++level)
+            {
+                for (int count = 0; count < ordersPerLevel; ++count)
+                    orders.push_back(RestingOrder{ id++, side, levelPrice(side, level), 100 });
+            }
+        }
+
+        Lcg rng(8);
+        for (size_t idx = orders.size(); idx > 1; --idx)
+            std::swap(orders[idx - 1], orders[rng.next() % idx]);
+        return orders;
+    }
+
+    // building a book order by order against building it in one pass, per resting order
+    void BM_LoadEnterOrder(benchmark::State& state)
+    {
+        const std::vector<RestingOrder> orders = restingOrders(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+        const bool ladder = state.range(2) != 0;
+
+        for (auto _ : state)
+        {
+            OrderBook book(1, bookConfig(ladder));
+            for (const RestingOrder& order : orders)
+                book.enterOrder(order.id_, order.side_, order.price_, order.quantity_);
+            benchmark::DoNotOptimize(book.getDepth());
+        }
+        state.SetItemsProcessed(state.iterations() * orders.size());
+    }
+    BENCHMARK(BM_LoadEnterOrder)->ArgNames({ "levels", "perLevel", "ladder" })->ArgsProduct({ { 10, 1000 }, { 10, 100 }, { 0, 1 } })->Unit(benchmark::kMillisecond);
+
+    void BM_LoadBulk(benchmark::State& state)
+    {
+        const std::vector<RestingOrder> orders = restingOrders(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+        const bool ladder = state.range(2) != 0;
+
+        for (auto _ : state)
+        {
+            OrderBook book(1, bookConfig(ladder));
+            if (!book.bulkLoad(orders))
+                state.SkipWithError("bulk load refused the orders");
+            benchmark::DoNotOptimize(book.getDepth());
+        }
+        state.SetItemsProcessed(state.iterations() * orders.size());
+    }
+    BENCHMARK(BM_LoadBulk)->ArgNames({ "levels", "perLevel", "ladder" })->ArgsProduct({ { 10, 1000 }, { 10, 100 }, { 0, 1 } })->Unit(benchmark::kMillisecond);
+
+    // text messages through the manager. pairs of an order and its cancel keep the book at its depth
+    void BM_ActionString(benchmark::State& state)
+    {
+        const int levels = static_cast<int>(state.range(0));
+        OrderBookManager manager;
+        Lcg rng(6);
+
+        // resting depth on both sides, ids 1 .. 2 * levels
+        int id = 1;
+        for (char side : { SIDE::BUY, SIDE::SELL })
+        {
+            for (int level = 0; level < levels; ++level)
+                manager.action(ACTION::NEW, 1, id++, side, 100, levelPrice(side, level));
+        }
+
+        std::vector<std::string> msgs;
+        msgs.reserve(2 * BATCH);
+        for (int idx = 0; idx < BATCH; ++idx)
+        {
+            const char side = (rng.next() & 1) ? SIDE::BUY : SIDE::SELL;
+            const Price price = levelPrice(side, rng.range(0, levels - 1));
+            const int orderId = id + idx;
+            std::ostringstream add;
+            add << "N,1," << orderId << "," << side << "," << rng.range(1, 100) << "," << FormattedPrice(price, PRICE::DEFAULT_SCALE);
+            msgs.push_back(add.str());
+            msgs.push_back("R," + std::to_string(orderId) + "," + side + ",1,1");
+        }
+
+        size_t next = 0;
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(manager.action(msgs[next]));
+            if (++next == msgs.size())
+                next = 0;
+        }
+        state.SetItemsProcessed(state.iterations());
+        if (manager.getRejectCount())
+            state.SkipWithError("messages were rejected");
+    }
+    BENCHMARK(BM_ActionString)->ArgName("levels")->Arg(10)->Arg(1000);
+
+    // the parsing step of action(string) on its own
+    void BM_ParseMsg(benchmark::State& state)
+    {
+        const std::string msg = "N,1,123456,B,250,100.25";
+        ParsedMsg parsed;
+        Price price;
+
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(parseMsg(msg, parsed));
+            benchmark::DoNotOptimize(parsePrice(parsed.price_, PRICE::DEFAULT_SCALE, price));
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_ParseMsg);
+}
+
+BENCHMARK_MAIN();
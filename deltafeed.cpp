@@ -0,0 +1,214 @@
+#include "deltafeed.h"
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+size_t DeltaRing::roundUp(size_t capacity)
+{
+    size_t size = 2;
+    while (size < capacity)
+        size <<= 1;
+    return size;
+}
+
+size_t DeltaRing::bytesFor(size_t capacity)
+{
+    return sizeof(Header) + roundUp(capacity) * sizeof(Slot);
+}
+
+DeltaRing::DeltaRing(size_t capacity) :owned_(new unsigned char[bytesFor(capacity)])
+{
+    init(owned_.get(), capacity, true);
+}
+
+DeltaRing::DeltaRing(void* memory, size_t capacity, bool create)
+{
+    init(memory, capacity, create);
+}
+
+void DeltaRing::init(void* memory, size_t capacity, bool create)
+{
+    capacity = roundUp(capacity);
+    header_ = static_cast<Header*>(memory);
+    slots_ = reinterpret_cast<Slot*>(static_cast<unsigned char*>(memory) + sizeof(Header));
+    mask_ = capacity - 1;
+
+    if (create)
+    {
+        new (header_) Header;
+        std::memcpy(header_->magic_, "OBDELTA\0", sizeof(header_->magic_));
+        header_->capacity_ = capacity;
+        header_->published_.store(0, std::memory_order_relaxed);
+        for (size_t idx = 0; idx < capacity; ++idx)
+        {
+            Slot* slot = new (&slots_[idx]) Slot;
+            slot->seq_.store(0, std::memory_order_relaxed);
+            for (auto& word : slot->words_)
+                word.store(0, std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    else if (std::memcmp(header_->magic_, "OBDELTA\0", sizeof(header_->magic_)) != 0 || header_->capacity_ != capacity)
+        throw std::runtime_error("Memory does not hold a delta ring of that capacity");
+}
+
+void DeltaRing::push(const LevelDelta& delta)
+{
+    uint64_t words[WORDS];
+    std::memcpy(words, &delta, sizeof(delta));
+
+    const uint64_t seq = header_->published_.load(std::memory_order_relaxed) + 1;
+    Slot& slot = slots_[seq & mask_];
+
+    // readers still on the previous lap see the slot change underneath them
+    slot.seq_.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t idx = 0; idx < WORDS; ++idx)
+        slot.words_[idx].store(words[idx], std::memory_order_relaxed);
+    slot.seq_.store(seq, std::memory_order_release);
+
+    header_->published_.store(seq, std::memory_order_release);
+}
+
+DeltaRing::ReadStatus DeltaRing::read(uint64_t& cursor, LevelDelta& delta) const
+{
+    const uint64_t published = header_->published_.load(std::memory_order_acquire);
+    if (cursor == published)
+        return ReadStatus::EMPTY;
+
+    // too far behind, everything past the cursor has been overwritten already
+    if (published - cursor > mask_ + 1)
+    {
+        cursor = published - (mask_ + 1);
+        return ReadStatus::OVERRUN;
+    }
+
+    const uint64_t seq = cursor + 1;
+    const Slot& slot = slots_[seq & mask_];
+
+    uint64_t words[WORDS];
+    const uint64_t before = slot.seq_.load(std::memory_order_acquire);
+    for (size_t idx = 0; idx < WORDS; ++idx)
+        words[idx] = slot.words_[idx].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t after = slot.seq_.load(std::memory_order_relaxed);
+
+    if (before != seq || after != seq)
+    {
+        // the writer lapped us while copying
+        cursor = header_->published_.load(std::memory_order_acquire) - (mask_ + 1);
+        return ReadStatus::OVERRUN;
+    }
+
+    std::memcpy(&delta, words, sizeof(delta));
+    cursor = seq;
+    return ReadStatus::OK;
+}
+
+bool DepthRebuilder::apply(const LevelDelta& delta)
+{
+    Book& book = books_[delta.productId_];
+    if (book.stale_)
+        return false;
+
+    // already part of the state the product was reset from, the ring may still hold it after a resync
+    if (delta.seqNo_ <= book.lastSeqNo_)
+        return true;
+
+    if (delta.seqNo_ != book.lastSeqNo_ + 1)
+    {
+        book.stale_ = true;
+        return false;
+    }
+    book.lastSeqNo_ = delta.seqNo_;
+
+    const DepthLevel level{ delta.price_, delta.quantity_, delta.orderCount_ };
+    if (delta.side_ == SIDE::BUY)
+    {
+        if (delta.change_ == LevelChange::REMOVE)
+            book.bids_.erase(delta.price_);
+        else
+            book.bids_[delta.price_] = level;
+    }
+    else
+    {
+        if (delta.change_ == LevelChange::REMOVE)
+            book.offers_.erase(delta.price_);
+        else
+            book.offers_[delta.price_] = level;
+    }
+
+    return true;
+}
+
+size_t DepthRebuilder::poll(const DeltaRing& ring, uint64_t& cursor)
+{
+    size_t count = 0;
+    LevelDelta delta;
+
+    for (;;)
+    {
+        switch (ring.read(cursor, delta))
+        {
+        case DeltaRing::ReadStatus::EMPTY:
+            return count;
+        case DeltaRing::ReadStatus::OVERRUN:
+            for (auto& elem : books_)
+                elem.second.stale_ = true;
+            break;
+        case DeltaRing::ReadStatus::OK:
+            apply(delta);
+            ++count;
+            break;
+        }
+    }
+}
+
+bool DepthRebuilder::isStale(int productId) const
+{
+    auto it = books_.find(productId);
+    return it != books_.end() && it->second.stale_;
+}
+
+void DepthRebuilder::reset(int productId, uint64_t lastSeqNo)
+{
+    Book& book = books_[productId];
+    book.bids_.clear();
+    book.offers_.clear();
+    book.lastSeqNo_ = lastSeqNo;
+    book.stale_ = false;
+}
+
+void DepthRebuilder::setLevel(int productId, char side, const DepthLevel& level)
+{
+    Book& book = books_[productId];
+    if (side == SIDE::BUY)
+        book.bids_[level.price_] = level;
+    else
+        book.offers_[level.price_] = level;
+}
+
+DepthSnapshot DepthRebuilder::getDepth(int productId) const
+{
+    DepthSnapshot depth;
+
+    auto it = books_.find(productId);
+    if (it == books_.end())
+        return depth;
+
+    for (const auto& elem : it->second.bids_)
+    {
+        if (depth.bidCount_ == DepthSnapshot::LEVELS)
+            break;
+        depth.bids_[depth.bidCount_++] = elem.second;
+    }
+
+    for (const auto& elem : it->second.offers_)
+    {
+        if (depth.offerCount_ == DepthSnapshot::LEVELS)
+            break;
+        depth.offers_[depth.offerCount_++] = elem.second;
+    }
+
+    return depth;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "order.h"
+#include "orderevents.h"
+#include "depth.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <unordered_map>
+
+/*
+ * @brief : one price level change of a book on the wire. seqNo_ counts the level
+ * changes of the product from 1 without gaps, so a consumer knows when it has
+ * missed one and has to resync.
+ */
+struct LevelDelta
+{
+    uint64_t seqNo_;
+    Price price_;          // in the fixed point scale of the product
+    int32_t productId_;
+    int32_t quantity_;     // 0 once removed
+    int32_t orderCount_;
+    char side_;            // SIDE::BUY / SELL
+    LevelChange change_;
+    uint8_t reserved_[2];
+};
+
+static_assert(sizeof(LevelDelta) == 32, "LevelDelta is a wire format, keep it at 32 bytes");
+
+/*
+ * @brief : broadcast ring of LevelDelta records, one writer and any number of
+ * readers that never hold the writer back. A reader that falls more than the
+ * capacity behind gets told it was overrun instead of reading torn records.
+ * The ring can live in caller provided memory (e.g. a shared memory segment)
+ * so readers in other processes attach to the same records.
+ */
+class DeltaRing
+{
+private:
+    struct Header
+    {
+        char magic_[8];
+        uint64_t capacity_;
+        alignas(64) std::atomic<uint64_t> published_; // deltas written so far
+    };
+
+    static const size_t WORDS = sizeof(LevelDelta) / sizeof(uint64_t);
+
+    struct Slot
+    {
+        std::atomic<uint64_t> seq_; // position of the delta held, 0 while it is being written
+        std::atomic<uint64_t> words_[WORDS];
+    };
+
+    std::unique_ptr<unsigned char[]> owned_;
+    Header* header_;
+    Slot* slots_;
+    uint64_t mask_;
+
+    void init(void* memory, size_t capacity, bool create);
+
+    // do not copy
+    DeltaRing(const DeltaRing&) = delete;
+    DeltaRing& operator=(const DeltaRing&) = delete;
+
+public:
+    // capacity is rounded up to a power of two
+    explicit DeltaRing(size_t capacity);
+    // lay the ring out in memory of bytesFor(capacity) bytes, or attach to the one already laid out there. throws on a mismatch
+    DeltaRing(void* memory, size_t capacity, bool create);
+
+    static size_t roundUp(size_t capacity);
+    static size_t bytesFor(size_t capacity);
+
+    // writer side, one thread only
+    void push(const LevelDelta& delta);
+
+    enum class ReadStatus { EMPTY, OK, OVERRUN };
+    // reader side. cursor is the count of deltas consumed so far, it moves past whatever was lost on an overrun
+    ReadStatus read(uint64_t& cursor, LevelDelta& delta) const;
+
+    uint64_t published() const { return header_->published_.load(std::memory_order_acquire); }
+    size_t capacity() const { return static_cast<size_t>(mask_ + 1); }
+};
+
+/*
+ * @brief : consumer side depth of every product, rebuilt from the deltas alone.
+ * A product that misses a delta is dropped until it is reset and fed again from
+ * a fresh book state.
+ */
+class DepthRebuilder
+{
+private:
+    struct Book
+    {
+        std::map<Price, DepthLevel, std::greater<Price>> bids_;
+        std::map<Price, DepthLevel> offers_;
+        uint64_t lastSeqNo_ = 0;
+        bool stale_ = false;
+    };
+
+    std::unordered_map<int, Book> books_;
+
+public:
+    // false when the delta does not follow the last one of its product, which is then stale. deltas up to
+    // the last one are skipped, so polling can go on from the same cursor after a reset
+    bool apply(const LevelDelta& delta);
+    // drain whatever the ring holds past the cursor. an overrun makes every product stale
+    size_t poll(const DeltaRing& ring, uint64_t& cursor);
+
+    bool isStale(int productId) const;
+    // start the product over from the book state as of lastSeqNo, seeded level by level with setLevel
+    void reset(int productId, uint64_t lastSeqNo = 0);
+    void setLevel(int productId, char side, const DepthLevel& level);
+    void clear() { books_.clear(); }
+
+    DepthSnapshot getDepth(int productId) const;
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "price.h"
+
+// aggregate of one price level
+struct DepthLevel
+{
+    Price price_;
+    int quantity_;
+    int orderCount_;
+};
+
+// top LEVELS price levels of both sides, best first. only the first bidCount_/offerCount_ entries are set
+struct DepthSnapshot
+{
+    static const int LEVELS = 10;
+
+    DepthLevel bids_[LEVELS];
+    DepthLevel offers_[LEVELS];
+    int bidCount_ = 0;
+    int offerCount_ = 0;
+
+    // last trade of the book and the total traded at its price. level deltas do not carry trades, a
+    // depth rebuilt from them leaves these at 0
+    Price lastTradedPrice_ = 0;
+    int lastTradedQty_ = 0;
+};
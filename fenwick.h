@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/*
+ * @brief : Fenwick (binary indexed) tree over a fixed number of positions.
+ * Point updates, prefix sums and the search for the first position whose
+ * prefix sum reaches a target all take log n. Positions are 0 based and the
+ * values are expected to stay non negative for lowerBound to hold.
+ */
+template<class T>
+class FenwickTree
+{
+private:
+    std::vector<T> tree_; // 1 based, tree_[0] unused
+    size_t topStep_ = 0; // highest power of two not above the size
+
+public:
+    FenwickTree() = default;
+    explicit FenwickTree(size_t size) { reset(size); }
+
+    void reset(size_t size)
+    {
+        tree_.assign(size + 1, T());
+        topStep_ = size ? 1 : 0;
+        while (topStep_ && topStep_ * 2 <= size)
+            topStep_ *= 2;
+    }
+
+    size_t size() const { return tree_.empty() ? 0 : tree_.size() - 1; }
+    size_t memoryUsage() const { return tree_.capacity() * sizeof(T); }
+
+    void add(size_t pos, T delta)
+    {
+        for (size_t idx = pos + 1; idx < tree_.size(); idx += idx & (~idx + 1))
+            tree_[idx] += delta;
+    }
+
+    // sum of the positions 0 .. pos, inclusive
+    T prefix(size_t pos) const
+    {
+        T sum = T();
+        for (size_t idx = pos + 1; idx; idx -= idx & (~idx + 1))
+            sum += tree_[idx];
+        return sum;
+    }
+
+    T total() const { return size() ? prefix(size() - 1) : T(); }
+
+    // first position whose prefix sum is at or above target, size() when the total falls short
+    size_t lowerBound(T target) const
+    {
+        size_t pos = 0;
+        for (size_t step = topStep_; step; step >>= 1)
+        {
+            if (pos + step < tree_.size() && tree_[pos + step] < target)
+            {
+                pos += step;
+                target -= tree_[pos];
+            }
+        }
+        return pos;
+    }
+
+    // O(n) build from the values of every position
+    template<class Value>
+    void build(size_t size, Value value)
+    {
+        reset(size);
+        for (size_t idx = 1; idx < tree_.size(); ++idx)
+        {
+            tree_[idx] += value(idx - 1);
+            const size_t parent = idx + (idx & (~idx + 1));
+            if (parent < tree_.size())
+                tree_[parent] += tree_[idx];
+        }
+    }
+};
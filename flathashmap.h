@@ -0,0 +1,273 @@
+#pragma once
+
+#include "seqlock.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * @brief : open addressing hash map for integral keys. Entries sit inline in one
+ * power of two slot array and collisions probe linearly, so a lookup usually
+ * costs a single cache miss. Erase shifts the following entries back instead of
+ * leaving tombstones. EMPTY_KEY marks a free slot and can not be stored.
+ * Iterators and pointers are invalidated by any insertion or erase.
+ * One thread writes. Once enableSharedReads is called other threads may probe
+ * the map through findShared, see there. Values then only change through
+ * emplace and erase, which store into the slots readers probe with relaxed
+ * atomics (see SharedValue), not through operator[] or an iterator.
+ */
+/*
+ * @brief : how FlatHashMap::findShared copies a value out while the writer may
+ * be storing it, and how the writer stores one. Scalars go through relaxed
+ * atomics, a value made of several fields specialises this field by field.
+ */
+template<class Value>
+struct SharedValue
+{
+    static Value load(const Value& value) { return relaxedLoad(value); }
+    static void store(Value& slot, const Value& value) { relaxedStore(slot, value); }
+};
+
+template<class Key, class Value, Key EMPTY_KEY = std::numeric_limits<Key>::min()>
+class FlatHashMap
+{
+public:
+    typedef std::pair<Key, Value> value_type; // the key must not be modified in place
+
+private:
+    static_assert(std::is_integral<Key>::value, "keys are hashed as integers");
+
+    std::unique_ptr<value_type[]> slots_;
+    size_t capacity_ = 0;
+    size_t mask_ = 0;
+    size_t size_ = 0;
+    int shift_ = 64;
+
+    // every slot array goes out with its mask as one layout, so a reader never pairs an array with the
+    // mask of another. with shared reads the arrays a rehash replaces are kept till the map goes away
+    struct Layout
+    {
+        const value_type* slots_;
+        size_t mask_;
+        int shift_;
+    };
+
+    bool sharedReads_ = false;
+    std::vector<std::unique_ptr<value_type[]>> retiredSlots_;
+    size_t retiredCapacity_ = 0;
+    std::vector<std::unique_ptr<Layout>> layouts_;
+    std::atomic<const Layout*> layout_{ nullptr };
+
+    // fibonacci hashing spreads the sequential ids the gateways hand out
+    static size_t home(Key key, int shift) { return static_cast<size_t>((static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ULL) >> shift); }
+    size_t home(Key key) const { return home(key, shift_); }
+
+    // grow at 3/4 load to keep probe sequences short
+    static size_t slotsFor(size_t count)
+    {
+        size_t capacity = 16;
+        while (capacity * 3 < count * 4)
+            capacity <<= 1;
+        return capacity;
+    }
+
+    void rehash(size_t capacity)
+    {
+        std::unique_ptr<value_type[]> old(std::move(slots_));
+        const size_t oldCapacity = capacity_;
+
+        slots_.reset(new value_type[capacity]);
+        capacity_ = capacity;
+        mask_ = capacity - 1;
+        shift_ = 64;
+        for (size_t bits = capacity; bits > 1; bits >>= 1)
+            --shift_;
+        for (size_t idx = 0; idx < capacity; ++idx)
+            slots_[idx].first = EMPTY_KEY;
+
+        for (size_t idx = 0; idx < oldCapacity; ++idx)
+        {
+            if (old[idx].first == EMPTY_KEY)
+                continue;
+
+            size_t pos = home(old[idx].first);
+            while (slots_[pos].first != EMPTY_KEY)
+                pos = (pos + 1) & mask_;
+            slots_[pos] = std::move(old[idx]);
+        }
+
+        layouts_.emplace_back(new Layout{ slots_.get(), mask_, shift_ });
+        layout_.store(layouts_.back().get(), std::memory_order_release);
+        if (sharedReads_ && old)
+        {
+            retiredSlots_.push_back(std::move(old));
+            retiredCapacity_ += oldCapacity;
+        }
+    }
+
+    // stores into the slot array readers probe
+    static void storeSlot(value_type& slot, Key key, const Value& value)
+    {
+        SharedValue<Value>::store(slot.second, value);
+        relaxedStore(slot.first, key);
+    }
+
+    size_t findSlot(Key key) const
+    {
+        if (!capacity_)
+            return capacity_;
+
+        for (size_t pos = home(key);; pos = (pos + 1) & mask_)
+        {
+            if (slots_[pos].first == key)
+                return pos;
+            if (slots_[pos].first == EMPTY_KEY)
+                return capacity_;
+        }
+    }
+
+    // backward shift deletion: pull up every following entry whose probe sequence passes the hole
+    void eraseSlot(size_t hole)
+    {
+        for (size_t pos = (hole + 1) & mask_; slots_[pos].first != EMPTY_KEY; pos = (pos + 1) & mask_)
+        {
+            const size_t want = home(slots_[pos].first);
+            if (((pos - want) & mask_) >= ((pos - hole) & mask_))
+            {
+                storeSlot(slots_[hole], slots_[pos].first, slots_[pos].second);
+                hole = pos;
+            }
+        }
+
+        storeSlot(slots_[hole], EMPTY_KEY, Value());
+        --size_;
+    }
+
+    // do not copy
+    FlatHashMap(const FlatHashMap&) = delete;
+    FlatHashMap& operator=(const FlatHashMap&) = delete;
+
+public:
+    template<class Slot>
+    class Iterator
+    {
+    private:
+        Slot* slot_;
+        Slot* end_;
+
+        void skipFree() { while (slot_ != end_ && slot_->first == EMPTY_KEY) ++slot_; }
+
+        friend class FlatHashMap;
+
+    public:
+        Iterator(Slot* slot, Slot* end) :slot_(slot), end_(end) { skipFree(); }
+
+        Slot& operator*() const { return *slot_; }
+        Slot* operator->() const { return slot_; }
+        Iterator& operator++() { ++slot_; skipFree(); return *this; }
+        bool operator==(const Iterator& rhs) const { return slot_ == rhs.slot_; }
+        bool operator!=(const Iterator& rhs) const { return slot_ != rhs.slot_; }
+    };
+
+    typedef Iterator<value_type> iterator;
+    typedef Iterator<const value_type> const_iterator;
+
+    FlatHashMap() = default;
+    explicit FlatHashMap(size_t expected) { reserve(expected); }
+
+    iterator begin() { return iterator(slots_.get(), slots_.get() + capacity_); }
+    iterator end() { return iterator(slots_.get() + capacity_, slots_.get() + capacity_); }
+    const_iterator begin() const { return const_iterator(slots_.get(), slots_.get() + capacity_); }
+    const_iterator end() const { return const_iterator(slots_.get() + capacity_, slots_.get() + capacity_); }
+
+    iterator find(Key key) { return iterator(slots_.get() + findSlot(key), slots_.get() + capacity_); }
+    const_iterator find(Key key) const { return const_iterator(slots_.get() + findSlot(key), slots_.get() + capacity_); }
+    bool contains(Key key) const { return findSlot(key) != capacity_; }
+
+    // no overwrite when the key is already present, as std::unordered_map::emplace
+    std::pair<iterator, bool> emplace(Key key, const Value& value)
+    {
+        if ((size_ + 1) * 4 > capacity_ * 3)
+            rehash(slotsFor(size_ + 1));
+
+        size_t pos = home(key);
+        for (; slots_[pos].first != EMPTY_KEY; pos = (pos + 1) & mask_)
+        {
+            if (slots_[pos].first == key)
+                return std::make_pair(iterator(slots_.get() + pos, slots_.get() + capacity_), false);
+        }
+
+        storeSlot(slots_[pos], key, value);
+        ++size_;
+        return std::make_pair(iterator(slots_.get() + pos, slots_.get() + capacity_), true);
+    }
+
+    Value& operator[](Key key) { return emplace(key, Value()).first->second; }
+
+    bool erase(Key key)
+    {
+        const size_t pos = findSlot(key);
+        if (pos == capacity_)
+            return false;
+
+        eraseSlot(pos);
+        return true;
+    }
+
+    void erase(iterator iter) { eraseSlot(static_cast<size_t>(iter.slot_ - slots_.get())); }
+
+    // from now on slot arrays outlive their rehash, so findShared is safe from other threads. costs at
+    // most the size of the current array again when the map keeps growing, nothing once it is reserved
+    void enableSharedReads() { sharedReads_ = true; }
+
+    // lookup from any thread, racing the writer. the entry copied out may be caught mid update and a key
+    // being moved may be missed, so a reader has to validate the outcome against a version the writer
+    // moves around its updates (see SeqCount). probes at most the whole array, never freed memory
+    bool findShared(Key key, Value& value) const
+    {
+        const Layout* layout = layout_.load(std::memory_order_acquire);
+        if (!layout)
+            return false;
+
+        size_t pos = home(key, layout->shift_);
+        for (size_t probes = 0; probes <= layout->mask_; ++probes, pos = (pos + 1) & layout->mask_)
+        {
+            const value_type& slot = layout->slots_[pos];
+            const Key slotKey = relaxedLoad(slot.first);
+            if (slotKey == key)
+            {
+                value = SharedValue<Value>::load(slot.second);
+                return true;
+            }
+            if (slotKey == EMPTY_KEY)
+                return false;
+        }
+        return false;
+    }
+
+    // make room for count entries without rehashing
+    void reserve(size_t count)
+    {
+        const size_t capacity = slotsFor(count);
+        if (capacity > capacity_)
+            rehash(capacity);
+    }
+
+    void clear()
+    {
+        for (size_t idx = 0; idx < capacity_; ++idx)
+            storeSlot(slots_[idx], EMPTY_KEY, Value());
+        size_ = 0;
+    }
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+    // bytes of the slot arrays, the ones kept for shared reads included
+    size_t memoryUsage() const { return (capacity_ + retiredCapacity_) * sizeof(value_type) + layouts_.size() * sizeof(Layout); }
+};
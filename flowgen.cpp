@@ -0,0 +1,391 @@
+// synthetic N/M/R/X order flow for load testing, reproducible from its seed. the flow is applied to real
+// books while it is generated, so a replay accepts every modify, cancel and trade of it
+#include "orderbookmanager.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    // splitmix64, the stream only depends on the seed
+    struct Rng
+    {
+        uint64_t state_;
+        explicit Rng(uint64_t seed) :state_(seed) {}
+        uint64_t next()
+        {
+            uint64_t z = (state_ += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        }
+        double uniform() { return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0); }
+        int range(int lo, int hi) { return lo + static_cast<int>(next() % static_cast<uint64_t>(hi - lo + 1)); }
+        bool chance(int pct) { return static_cast<int>(next() % 100) < pct; }
+    };
+
+    const Price TICK = 100; // 0.01 at the default scale
+    const int MAX_TICKS_AWAY = 50;
+
+    struct Options
+    {
+        uint64_t messages_ = 1000000;
+        int products_ = 100;
+        double zipf_ = 1.1; // exponent of the product activity, rank r trades with weight 1 / r^zipf
+        uint64_t seed_ = 1;
+        bool binary_ = false;
+        int tradePct_ = 5;
+        int cancelPct_ = 40;
+        int modifyPct_ = 10;
+        int walkPct_ = 10; // chance of the mid moving a tick before a message
+        int depth_ = 200; // live orders per product, above that new orders turn into cancels
+        const char* out_ = nullptr;
+    };
+
+    struct Product
+    {
+        std::unique_ptr<OrderBook> book_;
+        Price mid_;
+        std::vector<int> live_; // ids entered on the book, the filled ones are pruned lazily
+    };
+
+    // text in the cmds.txt format or a binary capture, as read by --replay
+    class Writer
+    {
+    private:
+        std::ostream& os_;
+        const bool binary_;
+        uint64_t seqNo_ = 0;
+
+    public:
+        Writer(std::ostream& os, bool binary) :os_(os), binary_(binary)
+        {
+            if (binary_)
+            {
+                const MsgFileHeader header = MsgFileHeader::make();
+                os_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            }
+        }
+
+        void write(char action, int productId, int orderId, char side, int quantity, Price price)
+        {
+            if (binary_)
+            {
+                const Msg msg = Msg::make(++seqNo_, action, (action == ACTION::NEW || action == ACTION::TRADE) ? productId : 0, orderId, side, quantity, price);
+                os_.write(reinterpret_cast<const char*>(&msg), sizeof(msg));
+                return;
+            }
+
+            os_ << action << ',';
+            switch (action)
+            {
+            case ACTION::NEW:
+                os_ << productId << ',' << orderId << ',' << side << ',';
+                break;
+            case ACTION::TRADE:
+                os_ << productId << ',';
+                break;
+            default:
+                os_ << orderId << ',' << side << ',';
+                break;
+            }
+            os_ << quantity << ',' << FormattedPrice(price, PRICE::DEFAULT_SCALE) << '\n';
+        }
+    };
+
+    class FlowGenerator
+    {
+    private:
+        const Options& options_;
+        Rng rng_;
+        Writer& writer_;
+
+        OrderIndex orderIndex_; // shared by the books, ids are unique across products
+        std::vector<Product> products_;
+        std::vector<double> activity_; // cumulative zipf weights by product rank
+
+        int nextId_ = 0;
+        uint64_t rejects_ = 0;
+
+        void check(Result result) { if (result != Result::OK) ++rejects_; }
+
+        // ids wrap past INT_MAX on long runs, skipping the ones still live
+        int newId()
+        {
+            do
+            {
+                nextId_ = (nextId_ == std::numeric_limits<int>::max()) ? 1 : nextId_ + 1;
+            } while (orderIndex_.contains(nextId_));
+            return nextId_;
+        }
+
+        size_t pickProduct()
+        {
+            const double draw = rng_.uniform() * activity_.back();
+            size_t lo = 0, hi = activity_.size() - 1;
+            while (lo < hi)
+            {
+                const size_t mid = (lo + hi) / 2;
+                if (activity_[mid] < draw)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            return lo;
+        }
+
+        int quantity() { return rng_.chance(50) ? rng_.range(1, 10) * 10 : rng_.range(1, 100); }
+
+        // a random live order of the product, false once none is left
+        bool pickLive(Product& product, size_t& idx, RestingOrder& order)
+        {
+            while (!product.live_.empty())
+            {
+                idx = rng_.next() % product.live_.size();
+                if (product.book_->getOrderFromId(product.live_[idx], order))
+                    return true;
+
+                // filled by a trade
+                product.live_[idx] = product.live_.back();
+                product.live_.pop_back();
+            }
+            return false;
+        }
+
+        // a passive order a few ticks away from the mid, geometrically less likely further out. it never crosses the book
+        int enter(int productId, Product& product)
+        {
+            if (product.live_.size() >= static_cast<size_t>(options_.depth_) && cancel(productId, product))
+                return 1;
+
+            int ticks = 1;
+            while (ticks < MAX_TICKS_AWAY && rng_.chance(70))
+                ++ticks;
+
+            const DepthSnapshot depth = product.book_->getDepth();
+            const char side = (rng_.next() & 1) ? SIDE::BUY : SIDE::SELL;
+            Price price;
+            if (side == SIDE::BUY)
+            {
+                price = product.mid_ - ticks * TICK;
+                if (depth.offerCount_ && price >= depth.offers_[0].price_)
+                    price = depth.offers_[0].price_ - TICK;
+            }
+            else
+            {
+                price = product.mid_ + ticks * TICK;
+                if (depth.bidCount_ && price <= depth.bids_[0].price_)
+                    price = depth.bids_[0].price_ + TICK;
+            }
+            if (price <= 0)
+                price = TICK;
+
+            const int orderId = newId();
+            const int qty = quantity();
+            writer_.write(ACTION::NEW, productId, orderId, side, qty, price);
+            check(product.book_->enterOrder(orderId, side, price, qty));
+            product.live_.push_back(orderId);
+            return 1;
+        }
+
+        bool cancel(int productId, Product& product)
+        {
+            size_t idx;
+            RestingOrder order{};
+            if (!pickLive(product, idx, order))
+                return false;
+
+            writer_.write(ACTION::REMOVE, productId, order.id_, order.side_, order.quantity_, order.price_);
+            check(product.book_->deleteOrder(order.id_));
+            product.live_[idx] = product.live_.back();
+            product.live_.pop_back();
+            return true;
+        }
+
+        bool modify(int productId, Product& product)
+        {
+            size_t idx;
+            RestingOrder order{};
+            if (!pickLive(product, idx, order))
+                return false;
+
+            const int qty = quantity();
+            writer_.write(ACTION::MODIFY, productId, order.id_, order.side_, qty, order.price_);
+            check(product.book_->modifyOrder(order.id_, qty));
+            return true;
+        }
+
+        // an aggressor taking part of the best opposite level, followed by the trade it prints. the book only
+        // fills it through the X message, so the trade always finds both sides
+        bool trade(int productId, Product& product)
+        {
+            const DepthSnapshot depth = product.book_->getDepth();
+
+            if (!depth.bidCount_ && !depth.offerCount_)
+                return false;
+
+            // lift the offers or hit the bids, whichever side has something left
+            char side = (rng_.next() & 1) ? SIDE::BUY : SIDE::SELL;
+            if (!(side == SIDE::BUY ? depth.offerCount_ : depth.bidCount_))
+                side = (side == SIDE::BUY) ? SIDE::SELL : SIDE::BUY;
+            const DepthLevel& level = (side == SIDE::BUY) ? depth.offers_[0] : depth.bids_[0];
+
+            const int orderId = newId();
+            const int qty = rng_.range(1, std::min(level.quantity_, 200));
+            writer_.write(ACTION::NEW, productId, orderId, side, qty, level.price_);
+            check(product.book_->enterOrder(orderId, side, level.price_, qty));
+            writer_.write(ACTION::TRADE, productId, 0, 0, qty, level.price_);
+            check(product.book_->handleTrade(level.price_, qty));
+
+            product.mid_ = level.price_;
+            return true;
+        }
+
+    public:
+        FlowGenerator(const Options& options, Writer& writer) :options_(options), rng_(options.seed_), writer_(writer)
+        {
+            orderIndex_.reserve(static_cast<size_t>(options.products_) * options.depth_);
+            products_.resize(options.products_);
+
+            double total = 0;
+            for (int rank = 1; rank <= options.products_; ++rank)
+            {
+                Product& product = products_[rank - 1];
+                product.book_.reset(new OrderBook(rank, ProductConfig(), &orderIndex_));
+                product.mid_ = rng_.range(10, 1000) * 100 * TICK;
+                product.live_.reserve(options.depth_);
+
+                total += 1.0 / std::pow(static_cast<double>(rank), options.zipf_);
+                activity_.push_back(total);
+            }
+        }
+
+        // one event, returns the messages it took
+        int step()
+        {
+            const size_t idx = pickProduct();
+            const int productId = static_cast<int>(idx) + 1;
+            Product& product = products_[idx];
+
+            if (rng_.chance(options_.walkPct_))
+                product.mid_ = std::max(product.mid_ + ((rng_.next() & 1) ? TICK : -TICK), 100 * TICK);
+
+            int dice = rng_.range(0, 99);
+            if ((dice -= options_.tradePct_) < 0)
+            {
+                if (trade(productId, product))
+                    return 2;
+            }
+            else if ((dice -= options_.cancelPct_) < 0)
+            {
+                if (cancel(productId, product))
+                    return 1;
+            }
+            else if ((dice -= options_.modifyPct_) < 0)
+            {
+                if (modify(productId, product))
+                    return 1;
+            }
+
+            return enter(productId, product);
+        }
+
+        uint64_t getRejects() const { return rejects_; }
+    };
+
+    void usage(const char* prog)
+    {
+        std::cerr << "usage: " << prog << " [--messages n] [--products n] [--zipf s] [--seed n] [--depth n]" << std::endl;
+        std::cerr << "              [--trade pct] [--cancel pct] [--modify pct] [--walk pct] [--binary] [--out file]" << std::endl;
+        std::cerr << "       text flow on stdout by default, --binary writes a capture for --replay" << std::endl;
+    }
+
+    bool parseOptions(int argc, char* argv[], Options& options)
+    {
+        for (int idx = 1; idx < argc; ++idx)
+        {
+            const char* name = argv[idx];
+            if (std::strcmp(name, "--binary") == 0)
+            {
+                options.binary_ = true;
+                continue;
+            }
+            if (idx + 1 == argc)
+                return false;
+
+            const char* value = argv[++idx];
+            if (std::strcmp(name, "--messages") == 0)
+                options.messages_ = std::strtoull(value, nullptr, 10);
+            else if (std::strcmp(name, "--products") == 0)
+                options.products_ = std::atoi(value);
+            else if (std::strcmp(name, "--zipf") == 0)
+                options.zipf_ = std::atof(value);
+            else if (std::strcmp(name, "--seed") == 0)
+                options.seed_ = std::strtoull(value, nullptr, 10);
+            else if (std::strcmp(name, "--depth") == 0)
+                options.depth_ = std::atoi(value);
+            else if (std::strcmp(name, "--trade") == 0)
+                options.tradePct_ = std::atoi(value);
+            else if (std::strcmp(name, "--cancel") == 0)
+                options.cancelPct_ = std::atoi(value);
+            else if (std::strcmp(name, "--modify") == 0)
+                options.modifyPct_ = std::atoi(value);
+            else if (std::strcmp(name, "--walk") == 0)
+                options.walkPct_ = std::atoi(value);
+            else if (std::strcmp(name, "--out") == 0)
+                options.out_ = value;
+            else
+                return false;
+        }
+
+        return options.products_ > 0 && options.depth_ > 0 && options.tradePct_ >= 0 && options.cancelPct_ >= 0 && options.modifyPct_ >= 0 &&
+            options.tradePct_ + options.cancelPct_ + options.modifyPct_ <= 100;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::ios::sync_with_stdio(false);
+    std::ofstream file;
+    if (options.out_)
+    {
+        file.open(options.out_, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            std::cerr << "Unable to open [" << options.out_ << "]" << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& os = options.out_ ? file : std::cout;
+
+    Writer writer(os, options.binary_);
+    FlowGenerator generator(options, writer);
+
+    uint64_t generated = 0;
+    while (generated < options.messages_)
+        generated += generator.step();
+
+    os.flush();
+    if (!os)
+    {
+        std::cerr << "Unable to write the flow" << std::endl;
+        return 1;
+    }
+
+    std::cerr << "Generated [" << generated << "] messages Rejected [" << generator.getRejects() << "]" << std::endl;
+    return generator.getRejects() ? 1 : 0;
+}
@@ -0,0 +1,195 @@
+#include "journal.h"
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#ifdef _WIN32
+    int openFile(const std::string& path) { return _open(path.c_str(), _O_RDWR | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE); }
+    long long fileSize(int fd) { return _lseeki64(fd, 0, SEEK_END); }
+    bool truncateFile(int fd, long long size) { return _chsize_s(fd, size) == 0; }
+    long long readAt(int fd, void* buffer, size_t size) { _lseeki64(fd, 0, SEEK_SET); return _read(fd, buffer, static_cast<unsigned>(size)); }
+    long long writeSome(int fd, const char* data, size_t size) { return _write(fd, data, static_cast<unsigned>(size)); }
+    bool syncFile(int fd) { return _commit(fd) == 0; }
+    void closeFile(int fd) { _close(fd); }
+#else
+    int openFile(const std::string& path) { return ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644); }
+    long long fileSize(int fd) { struct stat st; return (fstat(fd, &st) == 0) ? static_cast<long long>(st.st_size) : -1; }
+    bool truncateFile(int fd, long long size) { return ftruncate(fd, static_cast<off_t>(size)) == 0; }
+    long long readAt(int fd, void* buffer, size_t size) { return pread(fd, buffer, size, 0); }
+    long long writeSome(int fd, const char* data, size_t size) { return ::write(fd, data, size); }
+    bool syncFile(int fd) { return fdatasync(fd) == 0; }
+    void closeFile(int fd) { ::close(fd); }
+#endif
+
+    bool writeAll(int fd, const char* data, size_t size)
+    {
+        while (size)
+        {
+            const long long written = writeSome(fd, data, size);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+}
+
+bool Journal::open(const std::string& path, Durability durability, int intervalMs)
+{
+    close();
+
+    const int fd = openFile(path);
+    if (fd < 0)
+        return false;
+
+    const long long size = fileSize(fd);
+    bool valid = size >= 0;
+    if (valid && size == 0)
+    {
+        const MsgFileHeader header = MsgFileHeader::make();
+        valid = writeAll(fd, reinterpret_cast<const char*>(&header), sizeof(header)) && syncFile(fd);
+    }
+    else if (valid)
+    {
+        // only ever append to a journal of this build, minus whatever partial record a crash left behind
+        char header[sizeof(MsgFileHeader)];
+        valid = readAt(fd, header, sizeof(header)) == static_cast<long long>(sizeof(header)) && MsgFileHeader::matches(header, sizeof(header));
+
+        const long long torn = (size - static_cast<long long>(sizeof(MsgFileHeader))) % static_cast<long long>(sizeof(Msg));
+        if (valid && torn)
+            valid = truncateFile(fd, size - torn);
+    }
+
+    if (!valid)
+    {
+        closeFile(fd);
+        return false;
+    }
+
+    fd_ = fd;
+    durability_ = durability;
+    interval_ = std::chrono::milliseconds(intervalMs);
+    appended_ = 0;
+    written_.store(0);
+    durable_.store(0);
+    failed_.store(false);
+    running_.store(true, std::memory_order_release);
+    worker_ = std::thread(&Journal::run, this);
+    return true;
+}
+
+void Journal::close()
+{
+    if (fd_ < 0)
+        return;
+
+    running_.store(false, std::memory_order_release);
+    worker_.join();
+    closeFile(fd_);
+    fd_ = -1;
+}
+
+bool Journal::flush()
+{
+    syncRequested_.store(true, std::memory_order_release);
+    while (!failed() && getDurable() < appended_)
+        std::this_thread::yield();
+    return !failed();
+}
+
+bool Journal::sync()
+{
+    if (!syncFile(fd_))
+    {
+        failed_.store(true, std::memory_order_release);
+        return false;
+    }
+
+    durable_.store(written_.load(std::memory_order_relaxed), std::memory_order_release);
+    return true;
+}
+
+void Journal::run()
+{
+    std::vector<Msg> batch;
+    batch.reserve(BATCH_SIZE);
+
+    auto lastSync = std::chrono::steady_clock::now();
+    bool unsynced = false;
+    unsigned idleSpins = 0;
+
+    for (;;)
+    {
+        Msg msg;
+        while (batch.size() < BATCH_SIZE && queue_.tryPop(msg))
+            batch.push_back(msg);
+
+        if (!batch.empty() && !failed())
+        {
+            // one write for the whole batch
+            if (writeAll(fd_, reinterpret_cast<const char*>(batch.data()), batch.size() * sizeof(Msg)))
+            {
+                written_.fetch_add(batch.size(), std::memory_order_release);
+                unsynced = true;
+            }
+            else
+                failed_.store(true, std::memory_order_release);
+        }
+
+        const bool idle = batch.empty();
+        batch.clear();
+
+        if (unsynced && !failed())
+        {
+            const auto now = std::chrono::steady_clock::now();
+            bool syncNow = syncRequested_.exchange(false, std::memory_order_acq_rel);
+            if (durability_ == Durability::PER_BATCH)
+                syncNow = true;
+            else if (durability_ == Durability::INTERVAL && now - lastSync >= interval_)
+                syncNow = true;
+
+            if (durability_ == Durability::NONE && !syncNow)
+                durable_.store(written_.load(std::memory_order_relaxed), std::memory_order_release);
+            else if (syncNow && sync())
+            {
+                lastSync = now;
+                unsynced = false;
+            }
+        }
+
+        if (idle)
+        {
+            // stop only once the queue is drained and everything written is synced
+            if (!running_.load(std::memory_order_acquire) && queue_.empty())
+            {
+                if (unsynced && !failed())
+                    sync();
+                break;
+            }
+            // a flush or an INTERVAL sync waits at most IDLE_SLEEP more once the writer has gone to sleep
+            if (++idleSpins > IDLE_SPINS)
+                std::this_thread::sleep_for(IDLE_SLEEP);
+            else
+                std::this_thread::yield();
+        }
+        else
+            idleSpins = 0;
+    }
+}
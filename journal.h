@@ -0,0 +1,81 @@
+#pragma once
+
+#include "msgprotocol.h"
+#include "spscqueue.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+/*
+ * @brief : append only journal of the messages applied to the books. The apply
+ * path only queues the message, a background thread drains the queue in
+ * batches with one write each and syncs them to disk as configured, so the
+ * cost of a sync is shared by every message of the batch (group commit).
+ * The file is a MsgFileHeader followed by the Msg records, the binary capture
+ * format, so a journal replays through OrderBookManager::applyBatch.
+ */
+class Journal
+{
+public:
+    enum class Durability : uint8_t
+    {
+        NONE,       // written, left to the OS to sync
+        PER_BATCH,  // synced after every batch written
+        INTERVAL,   // synced at most every intervalMs
+    };
+
+private:
+    static const size_t BATCH_SIZE = 4096;
+    // an idle writer yields for that many rounds, then sleeps IDLE_SLEEP between looks at the queue
+    static const unsigned IDLE_SPINS = 1024;
+    static constexpr std::chrono::microseconds IDLE_SLEEP{ 50 };
+
+    int fd_ = -1;
+    Durability durability_ = Durability::PER_BATCH;
+    std::chrono::milliseconds interval_{ 0 };
+
+    SpscQueue<Msg> queue_;
+    std::thread worker_;
+    std::atomic<bool> running_{ false };
+    std::atomic<bool> syncRequested_{ false };
+    std::atomic<bool> failed_{ false };
+
+    uint64_t appended_ = 0; // apply path only
+    std::atomic<uint64_t> written_{ 0 };
+    std::atomic<uint64_t> durable_{ 0 };
+
+    void run();
+    bool sync();
+
+    // do not copy
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+public:
+    explicit Journal(size_t queueSize = 65536) :queue_(queueSize) {}
+    ~Journal() { close(); }
+
+    // append to the journal at path, creating it when missing. a torn record left at the end by a crash is cut off
+    bool open(const std::string& path, Durability durability = Durability::PER_BATCH, int intervalMs = 10);
+    // write and sync whatever is queued, then stop
+    void close();
+    bool isOpen() const { return fd_ >= 0; }
+
+    // apply path. never does I/O, spins only while the queue is full
+    void append(const Msg& msg)
+    {
+        while (!queue_.tryPush(msg))
+            std::this_thread::yield();
+        ++appended_;
+    }
+
+    // block till every message appended so far is synced (written only, when durability is NONE)
+    bool flush();
+
+    // true once a write or sync failed, nothing is written after that
+    bool failed() const { return failed_.load(std::memory_order_acquire); }
+    uint64_t getAppended() const { return appended_; }
+    uint64_t getWritten() const { return written_.load(std::memory_order_acquire); }
+    uint64_t getDurable() const { return durable_.load(std::memory_order_acquire); }
+};
@@ -1,27 +1,244 @@
-#include "orderbookmanager.h"
-#include <fstream>
-#include <string>
-
-int main()
-{
-	std::ifstream cmdsFile("cmds.txt");
-
-	OrderBookManager OBManager;
-	int lineNo = 0;
-
-	if (cmdsFile.is_open())
-	{
-		std::string line;
-		while (std::getline(cmdsFile, line)) {
-			OBManager.action(line);
-			if (++lineNo % 10 == 0)
-			{
-				OBManager.printOB();
-				OBManager.printExceptions();
-			}
-		}
-	}
-
-	OBManager.printOB();
-	OBManager.printExceptions();
-}
\ No newline at end of file
+#include "orderbookmanager.h"
+#include "shardedmanager.h"
+#include "mappedfile.h"
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+namespace
+{
+	void usage(const char* prog)
+	{
+		std::cerr << "usage: " << prog << " <cmdsfile>             apply the text commands and print the books as they go" << std::endl;
+		std::cerr << "       " << prog << " --replay <capturefile>  replay a text or binary capture silently and report the throughput" << std::endl;
+		std::cerr << "       " << prog << " --replay <capturefile> --shards <n>  same, spreading the products over n worker threads" << std::endl;
+		std::cerr << "       " << prog << " --replay <capturefile> [--load-snapshot <file>] [--save-snapshot <file>]" << std::endl;
+		std::cerr << "              warm start from a snapshot (messages it already holds are skipped as stale) and/or save one at the end" << std::endl;
+		std::cerr << "       " << prog << " --replay <capturefile> --journal <file>  also append the accepted messages to a journal, itself a binary capture" << std::endl;
+	}
+
+	// a whole positive number, anything else is refused rather than read as 0
+	bool parseCount(const char* text, int& count)
+	{
+		const char* end = text + std::strlen(text);
+		const std::from_chars_result result = std::from_chars(text, end, count);
+		return result.ec == std::errc() && result.ptr == end && count > 0;
+	}
+
+	// interactive walk through a text command file printing the books every 10 lines
+	int runCommands(const char* path)
+	{
+		std::ifstream cmdsFile(path);
+		if (!cmdsFile.is_open())
+		{
+			std::cerr << "Unable to open [" << path << "]" << std::endl;
+			return 1;
+		}
+
+		OrderBookManager OBManager;
+		LoggingEventListener logger(std::cout);
+		OBManager.setEventListener(&logger);
+		int lineNo = 0;
+
+		std::string line;
+		while (std::getline(cmdsFile, line)) {
+			OBManager.action(line);
+			if (++lineNo % 10 == 0)
+			{
+				OBManager.printOB();
+				OBManager.printExceptions();
+			}
+		}
+
+		OBManager.printOB();
+		OBManager.printExceptions();
+		return 0;
+	}
+
+	// parse every line straight out of the mapping
+	template<class Manager>
+	size_t replayText(Manager& OBManager, const char* data, size_t size)
+	{
+		size_t msgCount = 0;
+		const char* end = data + size;
+
+		while (data < end)
+		{
+			const char* eol = static_cast<const char*>(std::memchr(data, '\n', static_cast<size_t>(end - data)));
+			if (!eol)
+				eol = end;
+
+			if (eol != data)
+			{
+				OBManager.action(std::string_view(data, static_cast<size_t>(eol - data)));
+				++msgCount;
+			}
+			data = eol + 1;
+		}
+
+		return msgCount;
+	}
+
+	// the records of a binary capture, a torn last record is reported and left out
+	std::span<const Msg> binaryRecords(const MappedFile& file, const char* path)
+	{
+		size_t tornBytes;
+		const std::span<const Msg> msgs = MsgFileHeader::records(file.data(), file.size(), tornBytes);
+		if (tornBytes)
+			std::cerr << "Ignoring a truncated record of [" << tornBytes << "] bytes at the end of [" << path << "]" << std::endl;
+		return msgs;
+	}
+
+	void printThroughput(size_t msgCount, bool binary, const std::chrono::duration<double>& elapsed, uint64_t rejected)
+	{
+		const double secs = elapsed.count();
+		std::cout << "Replayed [" << msgCount << "] " << (binary ? "binary" : "text") << " messages in [" << secs << "] secs" << std::endl;
+		std::cout << "Throughput [" << (secs > 0 ? static_cast<double>(msgCount) / secs : 0.0) << "] msgs/sec Rejected [" << rejected << "]" << std::endl;
+	}
+
+	int replay(const char* path, const char* loadPath, const char* savePath, const char* journalPath)
+	{
+		MappedFile file;
+		if (!file.open(path))
+		{
+			std::cerr << "Unable to map [" << path << "]" << std::endl;
+			return 1;
+		}
+
+		OrderBookManager OBManager;
+		if (loadPath)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			if (!OBManager.loadSnapshot(loadPath))
+			{
+				std::cerr << "Unable to load snapshot [" << loadPath << "]" << std::endl;
+				return 1;
+			}
+			const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			std::cout << "Loaded snapshot at seqNo [" << OBManager.getLastSeqNo() << "] in [" << elapsed.count() << "] secs" << std::endl;
+		}
+
+		Journal journal;
+		if (journalPath)
+		{
+			if (!journal.open(journalPath))
+			{
+				std::cerr << "Unable to open journal [" << journalPath << "]" << std::endl;
+				return 1;
+			}
+			OBManager.setJournal(&journal);
+		}
+
+		const bool binary = MsgFileHeader::matches(file.data(), file.size());
+
+		// the clock includes the journal catching up, so its cost shows in the throughput
+		const auto start = std::chrono::steady_clock::now();
+		const size_t msgCount = binary ? OBManager.applyBatch(binaryRecords(file, path)) : replayText(OBManager, file.data(), file.size());
+		if (journalPath && !journal.flush())
+		{
+			std::cerr << "Unable to write journal [" << journalPath << "]" << std::endl;
+			return 1;
+		}
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		printThroughput(msgCount, binary, elapsed, OBManager.getRejectCount());
+		OBManager.printStats(std::cout);
+		if (journalPath)
+			std::cout << "Journaled [" << journal.getDurable() << "] messages" << std::endl;
+
+		if (savePath && !OBManager.saveSnapshot(savePath))
+		{
+			std::cerr << "Unable to save snapshot [" << savePath << "]" << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	// the clock runs till every shard has drained its queue
+	int replaySharded(const char* path, int shardCount)
+	{
+		MappedFile file;
+		if (!file.open(path))
+		{
+			std::cerr << "Unable to map [" << path << "]" << std::endl;
+			return 1;
+		}
+		ShardedOrderBookManager OBManager(static_cast<size_t>(shardCount));
+		const bool binary = MsgFileHeader::matches(file.data(), file.size());
+		OBManager.start();
+
+		const auto start = std::chrono::steady_clock::now();
+		size_t msgCount;
+		if (binary)
+			msgCount = OBManager.submitBatch(binaryRecords(file, path));
+		else
+			msgCount = replayText(OBManager, file.data(), file.size());
+		OBManager.stop();
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		printThroughput(msgCount, binary, elapsed, OBManager.getRejectCount());
+		std::cout << "Dispatcher" << std::endl;
+		OBManager.getRejects().printCounters(std::cout);
+		for (size_t idx = 0; idx < OBManager.getShardCount(); ++idx)
+		{
+			std::cout << "Shard [" << idx << "]" << std::endl;
+			OBManager.getShard(idx).printStats(std::cout);
+		}
+		return 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc >= 3 && argc % 2 == 1 && std::strcmp(argv[1], "--replay") == 0)
+	{
+		const char* loadPath = nullptr;
+		const char* savePath = nullptr;
+		const char* journalPath = nullptr;
+		int shardCount = 0;
+
+		for (int idx = 3; idx < argc; idx += 2)
+		{
+			if (std::strcmp(argv[idx], "--shards") == 0)
+			{
+				if (!parseCount(argv[idx + 1], shardCount))
+				{
+					std::cerr << "Invalid shard count [" << argv[idx + 1] << "]" << std::endl;
+					return 1;
+				}
+			}
+			else if (std::strcmp(argv[idx], "--load-snapshot") == 0)
+				loadPath = argv[idx + 1];
+			else if (std::strcmp(argv[idx], "--save-snapshot") == 0)
+				savePath = argv[idx + 1];
+			else if (std::strcmp(argv[idx], "--journal") == 0)
+				journalPath = argv[idx + 1];
+			else
+			{
+				usage(argv[0]);
+				return 1;
+			}
+		}
+
+		// shards keep their books apart, snapshots and the journal are taken of a single manager
+		if (shardCount)
+		{
+			if (loadPath || savePath || journalPath)
+			{
+				usage(argv[0]);
+				return 1;
+			}
+			return replaySharded(argv[2], shardCount);
+		}
+
+		return replay(argv[2], loadPath, savePath, journalPath);
+	}
+
+	if (argc == 2 && argv[1][0] != '-')
+		return runCommands(argv[1]);
+
+	usage(argv[0]);
+	return 1;
+}
@@ -0,0 +1,106 @@
+#include "msgparser.h"
+#include "orderbookmanager.h"
+#include <charconv>
+
+namespace
+{
+    const int MAX_FIELDS = 7;
+
+    bool isSeparator(char c)
+    {
+        return c == ',' || c == ';' || c == ':' || c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    // split the message into at most MAX_FIELDS views, returns the field count or -1 when there are more
+    int splitFields(std::string_view msg, std::string_view (&fields)[MAX_FIELDS])
+    {
+        int count = 0;
+        const char* it = msg.data();
+        const char* end = it + msg.size();
+
+        while (it != end)
+        {
+            if (isSeparator(*it))
+            {
+                ++it;
+                continue;
+            }
+
+            const char* start = it;
+            while (it != end && !isSeparator(*it))
+                ++it;
+
+            if (count == MAX_FIELDS)
+                return -1;
+            fields[count++] = std::string_view(start, static_cast<size_t>(it - start));
+        }
+
+        return count;
+    }
+
+    // action, side and order type are one character each, "Buy" is not a side
+    bool toChar(std::string_view field, char& value)
+    {
+        if (field.size() != 1)
+            return false;
+        value = field[0];
+        return true;
+    }
+
+    bool toInt(std::string_view field, int& value)
+    {
+        const char* end = field.data() + field.size();
+        std::from_chars_result result = std::from_chars(field.data(), end, value);
+        return result.ec == std::errc() && result.ptr == end;
+    }
+}
+
+Result parseMsg(std::string_view msg, ParsedMsg& parsed)
+{
+    std::string_view fields[MAX_FIELDS];
+    const int count = splitFields(msg, fields);
+
+    if (count == 0)
+        return Result::EMPTY_MESSAGE;
+
+    parsed = ParsedMsg();
+    if (!toChar(fields[0], parsed.action_))
+        return Result::INVALID_ACTION;
+
+    switch (parsed.action_)
+    {
+    case ACTION::NEW:
+        if (count != 6 && count != 7)
+            return Result::INVALID_FIELD_COUNT;
+        if (!toInt(fields[1], parsed.productId_) || !toInt(fields[2], parsed.orderId_) || !toInt(fields[4], parsed.quantity_))
+            return Result::INVALID_NUMBER;
+        if (!toChar(fields[3], parsed.side_))
+            return Result::INVALID_SIDE;
+        parsed.price_ = fields[5];
+        parsed.orderType_ = ORDERTYPE::LIMIT;
+        if (count == 7 && !toChar(fields[6], parsed.orderType_))
+            return Result::INVALID_ORDER_TYPE;
+        break;
+    case ACTION::MODIFY:
+    case ACTION::REMOVE:
+        if (count != 5)
+            return Result::INVALID_FIELD_COUNT;
+        if (!toInt(fields[1], parsed.orderId_) || !toInt(fields[3], parsed.quantity_))
+            return Result::INVALID_NUMBER;
+        if (!toChar(fields[2], parsed.side_))
+            return Result::INVALID_SIDE;
+        parsed.price_ = fields[4];
+        break;
+    case ACTION::TRADE:
+        if (count != 4)
+            return Result::INVALID_FIELD_COUNT;
+        if (!toInt(fields[1], parsed.productId_) || !toInt(fields[2], parsed.quantity_))
+            return Result::INVALID_NUMBER;
+        parsed.price_ = fields[3];
+        break;
+    default:
+        return Result::INVALID_ACTION;
+    }
+
+    return Result::OK;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "result.h"
+#include <string_view>
+
+// fields of a text message. price stays as text till the scale of its product is known
+struct ParsedMsg
+{
+    char action_ = 0;
+    int productId_ = 0;
+    int orderId_ = 0;
+    char side_ = 0;
+    int quantity_ = 0;
+    std::string_view price_;
+    char orderType_ = 0; // only on new orders
+
+};
+
+/*
+ * @brief : splits a message on any of ",;: " (empty fields are skipped) and decodes
+ *    N,<productId>,<orderId>,<side>,<quantity>,<price>[,<orderType>]
+ *    M|R,<orderId>,<side>,<quantity>,<price>
+ *    X,<productId>,<quantity>,<price>
+ * An order type (ORDERTYPE::*) left out reads as a limit order. Action, side and
+ * order type have to be a single character.
+ * Parsing never throws nor allocates, failures come back as one of the parse results.
+ */
+Result parseMsg(std::string_view msg, ParsedMsg& parsed);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "order.h"
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+/*
+ * @brief : fixed size binary form of the N/M/R/X messages as produced by the gateways.
+ * Fields are in host byte order and prices are already in the fixed point scale of the
+ * product. A zero sequence number marks an unsequenced message.
+ */
+struct Msg
+{
+    uint64_t seqNo_;
+    Price price_;
+    int32_t productId_;   // 0 on modify/cancel when the gateway does not know it
+    int32_t orderId_;     // 0 on trades
+    int32_t quantity_;
+    char action_;         // ACTION::NEW / MODIFY / REMOVE / TRADE
+    char side_;           // SIDE::BUY / SELL, 0 on trades
+    char orderType_;      // ORDERTYPE::* on new orders, 0 reads as a limit order
+    uint8_t reserved_[1];
+
+    static Msg make(uint64_t seqNo, char action, int32_t productId, int32_t orderId, char side, int32_t quantity, Price price, char orderType = ORDERTYPE::LIMIT)
+    {
+        return Msg{ seqNo, price, productId, orderId, quantity, action, side, orderType, { 0 } };
+    }
+};
+
+static_assert(sizeof(Msg) == 32, "Msg is a wire format, keep it at 32 bytes");
+
+// binary message files (captures, journals) are this header followed by back to back Msg records
+struct MsgFileHeader
+{
+    char magic_[8];
+    uint32_t version_;
+    uint32_t msgSize_;
+
+    static const uint32_t VERSION = 1;
+
+    static MsgFileHeader make()
+    {
+        MsgFileHeader header;
+        std::memcpy(header.magic_, "OBMSGS\0\0", sizeof(header.magic_));
+        header.version_ = VERSION;
+        header.msgSize_ = sizeof(Msg);
+        return header;
+    }
+
+    // true when the buffer starts with a header this build can read
+    static bool matches(const char* data, size_t size)
+    {
+        if (size < sizeof(MsgFileHeader))
+            return false;
+
+        MsgFileHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        return std::memcmp(header.magic_, "OBMSGS\0\0", sizeof(header.magic_)) == 0 && header.version_ == VERSION && header.msgSize_ == sizeof(Msg);
+    }
+
+    // the whole records following the header of a buffer that matches. a record cut short at the end (a
+    // capture or journal torn mid write) is left out, its bytes come back in tornBytes
+    static std::span<const Msg> records(const char* data, size_t size, size_t& tornBytes)
+    {
+        const size_t bytes = size - sizeof(MsgFileHeader);
+        tornBytes = bytes % sizeof(Msg);
+        return std::span<const Msg>(reinterpret_cast<const Msg*>(data + sizeof(MsgFileHeader)), bytes / sizeof(Msg));
+    }
+};
+
+static_assert(sizeof(MsgFileHeader) % alignof(Msg) == 0, "records following the header have to stay aligned");
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "seqlock.h"
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// the pools stay on unless built with -DOB_DISABLE_POOLS, which sends every object and node to the heap one by
+// one. that build is the baseline allocbench measures the pools against, and is not for concurrent readers : a
+// released order goes back to the heap while a reader may still look at it
+
+/*
+ * @brief : ObjectPool hands out fixed size slots carved out of slabs and
+ * recycles released slots through an intrusive free list, so that creating and
+ * destroying objects in steady state never touches the heap.
+ * The first slab is small and each further one doubles the capacity, so a
+ * nearly empty pool costs little and a large one still grows in few steps.
+ * Slabs are only released with the pool itself.
+ */
+template<class T, size_t FIRST_SLAB = 16>
+class ObjectPool
+{
+private:
+    static_assert(std::is_trivially_destructible<T>::value, "pooled objects are released without running destructors");
+
+    union Slot
+    {
+        Slot* next_;
+        alignas(T) unsigned char storage_[sizeof(T)];
+    };
+
+    std::vector<std::unique_ptr<Slot[]>> slabs_;
+    Slot* freeList_ = nullptr;
+    size_t liveCount_ = 0;
+    size_t capacity_ = 0;
+
+    void grow(size_t slots)
+    {
+        slabs_.emplace_back(new Slot[slots]);
+        Slot* slab = slabs_.back().get();
+        for (size_t i = slots; i-- > 0;) // thread backwards so that slots are handed out in address order
+        {
+            slab[i].next_ = freeList_;
+            freeList_ = &slab[i];
+        }
+        capacity_ += slots;
+    }
+
+    // do not copy
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+public:
+    ObjectPool() = default;
+
+    template<class... Args>
+    T* create(Args&&... args)
+    {
+#ifdef OB_DISABLE_POOLS
+        Slot* slot = new Slot;
+        ++capacity_;
+#else
+        if (!freeList_)
+            grow(capacity_ ? capacity_ : FIRST_SLAB);
+
+        Slot* slot = freeList_;
+        freeList_ = slot->next_;
+#endif
+        ++liveCount_;
+        return new (slot->storage_) T(std::forward<Args>(args)...);
+    }
+
+    // the free list link overwrites the head of the object, relaxed as a concurrent reader may still be
+    // looking at the object (see SeqCount)
+    void destroy(T* object)
+    {
+        Slot* slot = reinterpret_cast<Slot*>(object);
+#ifdef OB_DISABLE_POOLS
+        delete slot;
+        --capacity_;
+#else
+        relaxedStore(slot->next_, freeList_);
+        freeList_ = slot;
+#endif
+        --liveCount_;
+    }
+
+    // make sure that the next count creations are served without growing
+    void reserve(size_t count)
+    {
+#ifndef OB_DISABLE_POOLS
+        if (count > capacity_ - liveCount_)
+            grow(count - (capacity_ - liveCount_));
+#endif
+    }
+
+    size_t size() const { return liveCount_; }
+    size_t capacity() const { return capacity_; }
+    // bytes of the slabs, free slots included
+    size_t memoryUsage() const { return capacity_ * sizeof(Slot) + slabs_.capacity() * sizeof(std::unique_ptr<Slot[]>); }
+};
+
+/*
+ * @brief : stl allocator serving single node allocations of node based
+ * containers (map, set, unordered_map) from a thread local free list of same
+ * sized blocks. Bulk requests such as hash bucket arrays go to the heap.
+ */
+template<class T>
+class PoolAllocator
+{
+private:
+    struct FreeList
+    {
+        struct Node { Node* next_; };
+        Node* head_ = nullptr;
+
+        ~FreeList()
+        {
+            while (head_)
+            {
+                Node* node = head_;
+                head_ = head_->next_;
+                ::operator delete(node);
+            }
+        }
+    };
+
+    // one list per node type, shared by every container of the thread
+    static FreeList& freeList()
+    {
+        static thread_local FreeList list;
+        return list;
+    }
+
+    static const size_t BLOCK_SIZE = sizeof(T) < sizeof(void*) ? sizeof(void*) : sizeof(T);
+#ifdef OB_DISABLE_POOLS
+    static const bool POOLED = false;
+#else
+    static const bool POOLED = true;
+#endif
+
+public:
+    typedef T value_type;
+
+    PoolAllocator() = default;
+    template<class U> PoolAllocator(const PoolAllocator<U>&) {}
+
+    T* allocate(size_t n)
+    {
+        if (!POOLED || n != 1)
+            return std::allocator<T>().allocate(n);
+
+        FreeList& list = freeList();
+        if (list.head_)
+        {
+            typename FreeList::Node* node = list.head_;
+            list.head_ = node->next_;
+            return reinterpret_cast<T*>(node);
+        }
+
+        return static_cast<T*>(::operator new(BLOCK_SIZE));
+    }
+
+    void deallocate(T* ptr, size_t n)
+    {
+        if (!POOLED || n != 1)
+        {
+            std::allocator<T>().deallocate(ptr, n);
+            return;
+        }
+
+        FreeList& list = freeList();
+        typename FreeList::Node* node = reinterpret_cast<typename FreeList::Node*>(ptr);
+        node->next_ = list.head_;
+        list.head_ = node;
+    }
+
+    template<class U> bool operator==(const PoolAllocator<U>&) const { return true; }
+    template<class U> bool operator!=(const PoolAllocator<U>&) const { return false; }
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "price.h"
+#include "seqlock.h"
+#include <cstdint>
+
+namespace SIDE
+{
+	const char BUY = 'B';
+	const char SELL = 'S';
+}
+
+// how an incoming order trades when the book matches. a replica book only takes limit orders
+namespace ORDERTYPE
+{
+	const char LIMIT = 'L';   // trade up to the limit price, rest the remainder
+	const char MARKET = 'M';  // trade at any price, cancel the remainder
+	const char IOC = 'I';     // trade up to the limit price, cancel the remainder
+	const char FOK = 'F';     // trade the whole quantity up to the limit price or nothing
+}
+
+struct OrderList;
+
+// a resting order is only its queue node. price and side are those of the price level holding it, so the
+// node fits in 32 bytes, two to a cache line
+struct Order
+{
+	// intrusive links into the fifo queue of the price level holding the order
+	Order* prev_ = nullptr;
+	Order* next_ = nullptr;
+	// the level holding the order, with the side of the level in the lowest bit so that neither the order nor
+	// the level needs a field for it. 0 while the order is not queued
+	uintptr_t link_;
+
+	// link_, id_ and quantity_ are read by concurrent readers (see OrderBook::getOrderFromId) and written
+	// through relaxedStore, the slot may be a recycled one a reader still holds
+	int id_;
+	int quantity_;
+
+	Order(int id, int quantity)
+	{
+		relaxedStore(link_, uintptr_t(0));
+		relaxedStore(id_, id);
+		relaxedStore(quantity_, quantity);
+	}
+
+	OrderList* level() const { return levelOf(link_); }
+	char side() const { return sideOf(link_); }
+
+	// decode a link loaded once, so that the level and the side read belong together
+	static OrderList* levelOf(uintptr_t link) { return reinterpret_cast<OrderList*>(link & ~uintptr_t(1)); }
+	static char sideOf(uintptr_t link) { return (link & 1) ? SIDE::SELL : SIDE::BUY; }
+};
+
+static_assert(sizeof(void*) != 8 || sizeof(Order) == 32, "orders are packed two to a cache line");
+
+// maintain an orderlist based on the price it holds. orders are queued in time priority
+struct OrderList
+{
+    Price price_; // read by concurrent readers like the order fields
+    int totalQty_ = 0;
+    int orderCount_ = 0;
+    Order* head_ = nullptr;
+    Order* tail_ = nullptr;
+
+    // the level does not know its side, the BookSide owning it passes the side along when it queues an order
+    OrderList() :OrderList(0) {}
+    explicit OrderList(Price price) { relaxedStore(price_, price); }
+
+    bool empty() const { return head_ == nullptr; }
+
+    void pushBack(Order* order, char side)
+    {
+        relaxedStore(order->link_, reinterpret_cast<uintptr_t>(this) | uintptr_t(side == SIDE::SELL));
+        order->prev_ = tail_;
+        order->next_ = nullptr;
+        if (tail_)
+            tail_->next_ = order;
+        else
+            head_ = order;
+        tail_ = order;
+        totalQty_ += order->quantity_;
+        ++orderCount_;
+    }
+
+    // constant time removal from anywhere in the queue
+    void unlink(Order* order)
+    {
+        if (order->prev_)
+            order->prev_->next_ = order->next_;
+        else
+            head_ = order->next_;
+
+        if (order->next_)
+            order->next_->prev_ = order->prev_;
+        else
+            tail_ = order->prev_;
+
+        totalQty_ -= order->quantity_;
+        --orderCount_;
+        order->prev_ = order->next_ = nullptr;
+        relaxedStore(order->link_, uintptr_t(0));
+    }
+};
+
+static_assert(sizeof(void*) != 8 || sizeof(OrderList) == 32, "levels are packed two to a cache line, a ladder holds one per tick");
+static_assert(alignof(OrderList) > 1, "the lowest bit of a level address carries the side");
@@ -1,334 +1,733 @@
 #include "orderbook.h"
-#include <cmath>
+#include "deltafeed.h"
 #include <algorithm>
 
-void OrderBook::enterOrder(int id, char side, double price, int quantity)
+namespace
 {
-    // if id already exists throw error
-    if (orderIdHashMap_.find(id) != orderIdHashMap_.end())
+    // bulk load : turn the order count of each price of a side into the first place of the price in the
+    // sorted range, prices best first from place first on. returns the place past the side
+    template<char Side>
+    size_t layoutPrices(FlatHashMap<Price, size_t>& places, size_t first)
     {
-        throw std::runtime_error("Order with Id already exists");
+        std::vector<Price> prices;
+        prices.reserve(places.size());
+        for (const auto& entry : places)
+            prices.push_back(entry.first);
+        std::sort(prices.begin(), prices.end(), BookSide<Side>::isBetter);
+
+        for (Price price : prices)
+        {
+            size_t& place = places[price];
+            const size_t count = place;
+            place = first;
+            first += count;
+        }
+        return first;
     }
+}
+
+Result OrderBook::enterOrder(int id, char side, Price price, int quantity, char orderType) noexcept
+{
+    if (id <= 0)
+        return Result::INVALID_ORDER_ID;
+
+    // if id already exists reject
+    if (orderIndex_.contains(id))
+        return Result::DUPLICATE_ORDER_ID;
+
+    if (side != SIDE::BUY && side != SIDE::SELL)
+        return Result::INVALID_SIDE;
+
+    // an order without quantity would rest as an empty entry and throw the level totals and depth off
+    if (quantity <= 0)
+        return Result::INVALID_PRICE_QTY;
+
+    // anything but a plain limit order needs a matching book
+    if (orderType != ORDERTYPE::LIMIT && (!matching_ || (orderType != ORDERTYPE::MARKET && orderType != ORDERTYPE::IOC && orderType != ORDERTYPE::FOK)))
+        return Result::INVALID_ORDER_TYPE;
+
+    // both sides share the instrument's band, so either one can validate the price. market orders carry none
+    if (orderType != ORDERTYPE::MARKET && !bidLevels_.isValidPrice(price))
+        return Result::PRICE_OUT_OF_BAND;
+
+    return (side == SIDE::BUY) ? enterSide<SIDE::BUY>(id, price, quantity, orderType) : enterSide<SIDE::SELL>(id, price, quantity, orderType);
+}
 
-    // else add the order to the hash map and also add and update the set based on the side (if valid side)
-    switch (side)
+// the write scopes of the readers (see enableConcurrentReaders) span the stores of an operation, never a
+// listener call, so readers are not held up for as long as the listener runs
+template<char Side>
+Result OrderBook::enterSide(int id, Price price, int quantity, char orderType)
+{
+    listener_->onOrderAccepted(OrderAcceptedEvent{ productId_, id, Side, price, quantity, priceScale_ });
+
+    if (matching_)
     {
-    case SIDE::BUY:
-        orderIdHashMap_[id] = std::make_shared<Order>(id, side, price, quantity);
-        addOrUpdateSet(orderIdHashMap_[id], SIDE::BUY);
-        break;
-    case SIDE::SELL:
-        orderIdHashMap_[id] = std::make_shared<Order>(id, side, price, quantity);
-        addOrUpdateSet(orderIdHashMap_[id], SIDE::SELL);
-        break;
-    default:
-        throw std::runtime_error("Invalid SIDE received. Order Creation failed!!!");
+        quantity = matchOrder<Side>(id, price, quantity, orderType);
+        if (quantity == 0)
+        {
+            publishDepth();
+            return Result::OK;
+        }
+
+        if (orderType != ORDERTYPE::LIMIT)
+        {
+            // market, immediate or cancel and unfilled fill or kill orders never rest
+            listener_->onCancel(CancelEvent{ productId_, id, Side, price, quantity, priceScale_ });
+            publishDepth();
+            return Result::OK;
+        }
+    }
+
+    // add the order to the hash map and also add and update the set based on the side
+    Order* order;
+    bool newLevel;
+    {
+        SeqCount::WriteScope update(orderIndex_.version());
+        order = orderPool_.create(id, quantity);
+        orderIndex_.emplace(id, OrderHandle{ order, this });
+        newLevel = levels<Side>().add(order, price); // constant time on a ladder, logn insert cost for a new sparse price
+    }
+    notifyLevelChange<Side>(newLevel ? LevelChange::ADD : LevelChange::UPDATE, price, order->level()->totalQty_, order->level()->orderCount_);
+    publishDepth();
+    return Result::OK;
+}
+
+// trade the incoming order against the best levels of the other side in price time priority.
+// every match is reported as it happens, returns the quantity left
+template<char Side>
+int OrderBook::matchOrder(int id, Price price, int quantity, char orderType)
+{
+    constexpr char Opposite = opposite(Side);
+    BookSide<Opposite>& opposite = levels<Opposite>();
+    const bool anyPrice = (orderType == ORDERTYPE::MARKET);
+    auto crosses = [&](const OrderList* level) { return anyPrice || BookSide<Opposite>::crosses(level->price_, price); };
+
+    // fill or kill only trades when the whole quantity is there, only the crossing levels are looked at
+    if (orderType == ORDERTYPE::FOK)
+    {
+        int available = 0;
+        for (const OrderList* level = opposite.best(); level && available < quantity && crosses(level); level = opposite.next(level))
+            available += level->totalQty_;
+        if (available < quantity)
+            return quantity;
+    }
+
+    while (quantity > 0)
+    {
+        // the best level goes away once its last order fills, so look it up again every time
+        OrderList* level = opposite.best();
+        if (!level || !crosses(level))
+            break;
+
+        Order* resting = level->head_;
+        const Price tradePrice = level->price_;
+        const int fillQty = std::min(quantity, resting->quantity_);
+        quantity -= fillQty;
+        fillOrder<Opposite>(resting, fillQty);
+
+        if (quantity == 0)
+            listener_->onFill(FillEvent{ productId_, id, Side, tradePrice, fillQty, priceScale_ });
+        else
+            listener_->onPartialFill(PartialFillEvent{ productId_, id, Side, tradePrice, fillQty, quantity, priceScale_ });
+
+        recordTrade(tradePrice, fillQty);
     }
+
+    return quantity;
 }
 
 
-bool OrderBook::getOrderFromId(int id, Order& record)
+OrderIndex::iterator OrderBook::findOrder(int id)
 {
-    OrderIdHashMap::iterator iter = orderIdHashMap_.find(id);
+    OrderIndex::iterator iter = orderIndex_.find(id);
+    return (iter != orderIndex_.end() && iter->second.book_ == this) ? iter : orderIndex_.end();
+}
 
-    if (iter != orderIdHashMap_.end())
+// optimistic read, retried when an update ran through the index or the orders meanwhile
+bool OrderBook::getOrderFromId(int id, RestingOrder& record) const
+{
+    const SeqCount& version = orderIndex_.version();
+    for (;;)
     {
-        record = *iter->second.get();
-        return true;
+        const uint64_t seq = version.readBegin();
+
+        // an entry caught mid update may pair the key with a cleared handle
+        OrderHandle handle;
+        bool found = orderIndex_.findShared(id, handle) && handle.book_ == this && handle.order_;
+        if (found)
+        {
+            // same for an order caught between two levels
+            const Order& order = *handle.order_;
+            const uintptr_t link = relaxedLoad(order.link_);
+            const OrderList* level = Order::levelOf(link);
+            found = (level != nullptr);
+            if (found)
+                record = RestingOrder{ relaxedLoad(order.id_), Order::sideOf(link), relaxedLoad(level->price_), relaxedLoad(order.quantity_) };
+        }
+
+        if (version.readValidate(seq))
+            return found;
     }
+}
 
-    return false;
+Result OrderBook::modifyOrder(int id, int quantity) noexcept
+{
+    OrderIndex::iterator iter = findOrder(id);
+
+    if (iter != orderIndex_.end())
+        return modifyOrder(iter, quantity);
+
+    return (quantity <= 0) ? Result::INVALID_PRICE_QTY : Result::UNKNOWN_ORDER_ID;
 }
 
-bool OrderBook::modifyOrder(int id, int quantity)
+Result OrderBook::modifyOrder(OrderIndex::iterator handle, int quantity) noexcept
 {
     // sanity check on quantity
     if (quantity <= 0)
+        return Result::INVALID_PRICE_QTY;
+
+    // now that we have the order, need to update the order and also the orderlist holding it
+    Order* order = handle->second.order_;
+    int quantityDiff = quantity - order->quantity_;
     {
-        std::cerr << "Invalid quantity sent. Order modification failed!!!" << std::endl;
-        return false;
+        SeqCount::WriteScope update(orderIndex_.version());
+        relaxedStore(order->quantity_, quantity);
     }
 
-    OrderIdHashMap::iterator iter = orderIdHashMap_.find(id);
+    // update the quantity diff on the OrderList total quantity
+    OrderList* level = order->level();
+    level->totalQty_ = level->totalQty_ + quantityDiff;
+    if (order->side() == SIDE::BUY)
+        notifyLevelChange<SIDE::BUY>(LevelChange::UPDATE, level->price_, level->totalQty_, level->orderCount_);
+    else
+        notifyLevelChange<SIDE::SELL>(LevelChange::UPDATE, level->price_, level->totalQty_, level->orderCount_);
+    publishDepth();
+    return Result::OK;
+}
+
+// prints the published depth rather than the live levels, so any thread can print a consistent book
+void OrderBook::printOrderBook() const
+{
+    const DepthSnapshot depth = getDepth();
+
+    std::cout << "Printing Bid OrderBook (till level 5)" << std::endl;
+    for (int level = 0; level < depth.bidCount_ && level < 5; ++level)
+        std::cout << FormattedPrice(depth.bids_[level].price_, priceScale_) << " : " << depth.bids_[level].quantity_ << std::endl;
+
+    std::cout << "Printing Offer OrderBook (till level 5)" << std::endl;
+    for (int level = 0; level < depth.offerCount_ && level < 5; ++level)
+        std::cout << FormattedPrice(depth.offers_[level].price_, priceScale_) << " : " << depth.offers_[level].quantity_ << std::endl;
+}
+
+Result OrderBook::deleteOrder(int id) noexcept
+{
+    OrderIndex::iterator iter = findOrder(id);
+
+    if (iter != orderIndex_.end())
+        return deleteOrder(iter);
+
+    return Result::UNKNOWN_ORDER_ID;
+}
 
-    if (iter != orderIdHashMap_.end())
+Result OrderBook::deleteOrder(OrderIndex::iterator handle) noexcept
+{
+    const Order& order = *handle->second.order_;
+    const char side = order.side();
+    listener_->onCancel(CancelEvent{ productId_, order.id_, side, order.level()->price_, order.quantity_, priceScale_ });
+    if (side == SIDE::BUY)
+        eraseOrder<SIDE::BUY>(handle);
+    else
+        eraseOrder<SIDE::SELL>(handle);
+    publishDepth();
+    return Result::OK;
+}
+
+template<char Side>
+void OrderBook::eraseOrder(OrderIndex::iterator iter)
+{
+    // unlink the order from its level and drop the index entry at once, the id can be reused from now on.
+    // the order knows its level, so unlinking it is constant time whatever the queue length
+    Order* order = iter->second.order_;
+    const OrderList* level = order->level();
+    const Price price = level->price_;
+    bool levelGone;
     {
-        // now that we have the order, need to update the orderIdHashMap and also the orderListHashMap based on price
-        int quantityDiff = quantity - iter->second->quantity_;
-        iter->second->quantity_ = quantity;
-
-        OrderListHashMap& orderListHashMap = (iter->second->side_ == SIDE::BUY) ? bidOrderHashMap_ : offerOrderHashMap_;
-        // update the quantity diff on the OrderList total quantity
-        orderListHashMap[iter->second->price_]->totalQty_ = orderListHashMap[iter->second->price_]->totalQty_ + quantityDiff;
-        return true;
+        SeqCount::WriteScope update(orderIndex_.version());
+        levelGone = levels<Side>().remove(order);
+        orderIndex_.erase(iter);
+        orderPool_.destroy(order);
     }
 
-    return false;
+    if (levelGone)
+        notifyLevelChange<Side>(LevelChange::REMOVE, price, 0, 0);
+    else
+        notifyLevelChange<Side>(LevelChange::UPDATE, price, level->totalQty_, level->orderCount_);
 }
 
-void OrderBook::printOrderBook() const
+// a resting order trades fillQty at its own price, leaving the book once nothing is left of it
+template<char Side>
+void OrderBook::fillOrder(Order* order, int fillQty)
 {
-    std::cout << "Printing Bid OrderBook (till level 5)" << std::endl;
-    int level = 5;
-    for (AscendOrderSet::const_iterator iter = bidSet_.cbegin(); iter != bidSet_.cend(); ++iter)
+    if (fillQty == order->quantity_)
     {
-        std::cout << (*iter)->price_ << " : " << (*iter)->totalQty_ << std::endl;
-        if (--level == 0)
-            break;
+        listener_->onFill(FillEvent{ productId_, order->id_, Side, order->level()->price_, fillQty, priceScale_ });
+        eraseOrder<Side>(orderIndex_.find(order->id_));
+        return;
     }
 
-    level = 5;
-    std::cout << "Printing Offer OrderBook (till level 5)" << std::endl;
-    for (DescendOrderSet::const_iterator iter = offerSet_.cbegin(); iter != offerSet_.cend(); ++iter)
+    OrderList* level = order->level();
     {
-        std::cout << (*iter)->price_ << " : " << (*iter)->totalQty_ << std::endl;
-        if (--level == 0)
-            break;
+        SeqCount::WriteScope update(orderIndex_.version());
+        relaxedStore(order->quantity_, order->quantity_ - fillQty);
     }
+    level->totalQty_ -= fillQty;
+    listener_->onPartialFill(PartialFillEvent{ productId_, order->id_, Side, level->price_, fillQty, order->quantity_, priceScale_ });
+    notifyLevelChange<Side>(LevelChange::UPDATE, level->price_, level->totalQty_, level->orderCount_);
 }
 
-bool OrderBook::deleteOrder(int id)
+// fill the quantity in place from the best level down in time priority. canFill has to hold
+template<char Side>
+void OrderBook::consume(int quantity)
 {
-    OrderIdHashMap::iterator iter = orderIdHashMap_.find(id);
-
-    if (iter != orderIdHashMap_.end())
+    BookSide<Side>& side = levels<Side>();
+    while (quantity > 0)
     {
-        // found the element. now delete from the set and then delete from this hash map
-        auto status = deleteFromSet(iter->second, iter->second->side_);
-        orderIdHashMap_.erase(iter);
+        Order* order = side.best()->head_;
+        const int fillQty = std::min(quantity, order->quantity_);
+        quantity -= fillQty;
+        fillOrder<Side>(order, fillQty);
+    }
+}
+
+Result OrderBook::checkIfValidTradeAndUpdateOrderBook(const Price price, const int quantity) noexcept
+{
+    if (bidLevels_.empty() || offerLevels_.empty())
+        return Result::TRADE_ON_EMPTY_BOOK;
+
+    // check if price is inline with the top of the orderbook
+    if (bidLevels_.best()->price_ < price || offerLevels_.best()->price_ > price)
+        return Result::TRADE_PRICE_OUT_OF_BOOK;
+
+    // validate both sides before touching any, the trade applies entirely or not at all
+    if (!bidLevels_.canFill(price, quantity))
+        return Result::INSUFFICIENT_BUY_QTY;
+    if (!offerLevels_.canFill(price, quantity))
+        return Result::INSUFFICIENT_SELL_QTY;
+
+    consume<SIDE::BUY>(quantity);
+    consume<SIDE::SELL>(quantity);
+    return Result::OK;
+}
 
+Result OrderBook::handleTrade(Price price, int quantity) noexcept
+{
+    if (quantity <= 0)
+        return Result::INVALID_PRICE_QTY;
+
+    // update the order books
+    const Result status = checkIfValidTradeAndUpdateOrderBook(price, quantity);
+    if (status != Result::OK)
         return status;
-    }
 
-    return false;
-}
-
-void OrderBook::generateFills(const std::vector<int>& totalFills, const std::map<int, int>& partialFills)
-{
-    for (const auto& it : totalFills)
-    {
-        std::cout << "Order id [" << it << "] totally filled!!" << std::endl;
-        deleteOrder(it);
-    }
-
-    for (const auto& it : partialFills)
-    {
-        std::cout << "Order id [" << it.first << "] partially filled!! New Qty [" << it.second << "]" << std::endl;
-        modifyOrder(it.first, it.second);
-    }
-}
-
-bool OrderBook::checkIfValidTradeAndUpdateOrderBook(const double price, const int quantity)
-{
-    if (bidSet_.empty() || offerSet_.empty())
-        throw std::runtime_error("Trade received on empty order books!!");
-
-    // check if price is inline with the top of the orderbook
-    auto bIt = bidSet_.begin();
-    auto sIt = offerSet_.begin();
-
-    if ((*bIt)->price_ < price || (*sIt)->price_ > price)
-        throw std::runtime_error("Out of order Trade price received!!");
-
-    // update the buy side quantity .. starting with greatest price
-    std::vector<int> borderIdsToDelete, sorderIdsToDelete;
-    std::map<int, int> borderIdsToModify, sorderIdsToModify;
-
-    { // buy side
-        int tradeQty = quantity;
-        while (bIt != bidSet_.end())
-        {
-            if ((*bIt)->price_ < price) // buy level price less than trade price 
-                break;
-
-            if ((*bIt)->totalQty_ == tradeQty) // matched with first level quantity
-            {
-                for (const auto& it : (*bIt)->orderList_)
-                    borderIdsToDelete.emplace_back(it->id_);
-                tradeQty = 0;
-                break;
-            }
-            else if ((*bIt)->totalQty_ > tradeQty)
-            {
-                int& qty = tradeQty;
-                for (const auto& it : (*bIt)->orderList_)
-                {
-                    if (it->quantity_ == qty)
-                    {
-                        borderIdsToDelete.emplace_back(it->id_);
-                        qty = 0;
-                        break;
-                    }
-                    else if (it->quantity_ > qty)
-                    {
-                        borderIdsToModify[it->id_] = it->quantity_ - qty;
-                        qty = 0;
-                        break;
-
-                    }
-                    else
-                    {
-                        borderIdsToDelete.emplace_back(it->id_);
-                        qty -= it->quantity_;
-                    }
-                }
-                break;
-            }
-            else // tradeQty > current level quantity
-            {
-                for (const auto& it : (*bIt)->orderList_)
-                    borderIdsToDelete.emplace_back(it->id_);
-                tradeQty -= (*bIt)->totalQty_;
-                bIt++;
-            }
-        }
-
-        if (tradeQty > 0)
-            throw std::runtime_error("Insufficient quantity to fill from Buy side OrderBook!!");
-    }
-
-    { // sell side
-        int tradeQty = quantity;
-        while (sIt != offerSet_.end())
-        {
-            if ((*sIt)->price_ > price) // sell level price greater than trade price 
-                break;
-
-            if ((*sIt)->totalQty_ == tradeQty) // matched with first level quantity
-            {
-                for (const auto& it : (*sIt)->orderList_)
-                    sorderIdsToDelete.emplace_back(it->id_);
-                tradeQty = 0;
-                break;
-            }
-            else if ((*sIt)->totalQty_ > tradeQty)
-            {
-                int& qty = tradeQty;
-                for (const auto& it : (*sIt)->orderList_)
-                {
-                    if (it->quantity_ == qty)
-                    {
-                        sorderIdsToDelete.emplace_back(it->id_);
-                        qty = 0;
-                        break;
-                    }
-                    else if (it->quantity_ > qty)
-                    {
-                        sorderIdsToModify[it->id_] = it->quantity_ - qty;
-                        qty = 0;
-                        break;
-
-                    }
-                    else
-                    {
-                        sorderIdsToDelete.emplace_back(it->id_);
-                        qty -= it->quantity_;
-                    }
-                }
-                break;
-            }
-            else // tradeQty > current level quantity
-            {
-                for (const auto& it : (*sIt)->orderList_)
-                    sorderIdsToDelete.emplace_back(it->id_);
-                tradeQty -= (*sIt)->totalQty_;
-                sIt++;
-            }
-        }
-
-        if (tradeQty > 0)
-            throw std::runtime_error("Insufficient quantity to fill from Sell side OrderBook!!");
-    }
-
-    // now update the order books
-    generateFills(borderIdsToDelete, borderIdsToModify);
-    generateFills(sorderIdsToDelete, sorderIdsToModify);
-
-    // direct order book update without fills
-    //std::for_each(borderIdsToDelete.begin(), borderIdsToDelete.end(), [this](int id) { deleteOrder(id);  });
-    //std::for_each(sorderIdsToDelete.begin(), sorderIdsToDelete.end(), [this](int id) { deleteOrder(id);  });
-    //std::for_each(borderIdsToModify.begin(), borderIdsToModify.end(), [this](std::pair<const int, int>& it) { modifyOrder(it.first, it.second); });
-    //std::for_each(sorderIdsToModify.begin(), sorderIdsToModify.end(), [this](std::pair<const int, int>& it) { modifyOrder(it.first, it.second); });
-
-    return true;
-}
-
-bool OrderBook::handleTrade(double price, int quantity)
-{
-    // update the order books
-    const bool status = checkIfValidTradeAndUpdateOrderBook(price, quantity);
-
-    if (status)
-    {
-        if (fabs(lastTradedPrice_ - price) < std::numeric_limits<double>::epsilon())
-        {
-            lastTradedQuantity_ += quantity;
-        }
-        else
-        {
-            lastTradedPrice_ = price;
-            lastTradedQuantity_ = quantity;
-        }
-
-        std::cout << "Trade Received for productId [" << productId_ << "] Total Traded Quantity [" << lastTradedQuantity_ << "] Traded Price [" << lastTradedPrice_ << "]" << std::endl;
-    }
-    else
-    {
-        throw std::runtime_error("Applying trade failed for orderbook!!");
-    }
-
-    return false;
-}
-
-void OrderBook::addOrUpdateSet(OrderPtr& orderPtr, char side)
-{
-    OrderListHashMap& orderListHashMap = (side == SIDE::BUY) ? bidOrderHashMap_ : offerOrderHashMap_;
-    OrderListHashMap::iterator iter = orderListHashMap.find(orderPtr->price_);
-    if (iter != orderListHashMap.end())
+    recordTrade(price, quantity);
+    publishDepth();
+    return Result::OK;
+}
+
+void OrderBook::recordTrade(Price price, int quantity)
+{
+    if (depth_.lastTradedPrice_ == price)
     {
-        // price already exists
-        iter->second->totalQty_ = iter->second->totalQty_ + orderPtr->quantity_;
-        iter->second->orderList_.push_back(orderPtr);
+        depth_.lastTradedQty_ += quantity;
     }
     else
     {
-        // new price .. need to insert into set
-        orderListHashMap[orderPtr->price_] = std::make_shared<OrderList>(orderPtr);
-        if (side == SIDE::BUY)
-            bidSet_.insert(orderListHashMap[orderPtr->price_]); // logn insert cost since bst
-        else
-            offerSet_.insert(orderListHashMap[orderPtr->price_]); // logn insert cost since bst
+        depth_.lastTradedPrice_ = price;
+        depth_.lastTradedQty_ = quantity;
+    }
+    depthDirty_ = true;
+
+    listener_->onTrade(TradeEvent{ productId_, price, quantity, depth_.lastTradedQty_, priceScale_ });
+}
+
+template<char Side>
+void OrderBook::notifyLevelChange(LevelChange change, Price price, int totalQty, int orderCount)
+{
+    updateDepth<Side>(change, price, totalQty, orderCount);
+    levels<Side>().indexLevel(price, totalQty);
+
+    publishLevelChange<Side>(change, price, totalQty, orderCount);
+}
+
+// counted, numbered and sent out as a delta and an event
+template<char Side>
+void OrderBook::publishLevelChange(LevelChange change, Price price, int totalQty, int orderCount)
+{
+#ifndef OB_DISABLE_STATS
+    if (change == LevelChange::ADD)
+    {
+        ++counters_.levelsCreated_;
+        size_t& peak = (Side == SIDE::BUY) ? counters_.peakBidLevels_ : counters_.peakOfferLevels_;
+        peak = std::max(peak, levels<Side>().size());
+    }
+    else if (change == LevelChange::REMOVE)
+        ++counters_.levelsDestroyed_;
+#endif
+
+    ++deltaSeqNo_;
+    if (deltaRing_)
+        deltaRing_->push(LevelDelta{ deltaSeqNo_, price, productId_, totalQty, orderCount, Side, change, { 0, 0 } });
+    listener_->onLevelChange(LevelChangeEvent{ productId_, Side, change, price, totalQty, orderCount, priceScale_ });
+}
+
+// keep the cached top levels of a side in step with the book. only changes within the cached depth cost anything
+template<char Side>
+void OrderBook::updateDepth(LevelChange change, Price price, int totalQty, int orderCount)
+{
+    DepthLevel* levels = (Side == SIDE::BUY) ? depth_.bids_ : depth_.offers_;
+    int& count = (Side == SIDE::BUY) ? depth_.bidCount_ : depth_.offerCount_;
+
+    // position of the price among the cached levels, or where it would go
+    int pos = 0;
+    while (pos < count && BookSide<Side>::isBetter(levels[pos].price_, price))
+        ++pos;
+    const bool cached = (pos < count && levels[pos].price_ == price);
+
+    switch (change)
+    {
+    case LevelChange::ADD:
+    {
+        if (pos == DepthSnapshot::LEVELS)
+            return; // deeper than the cache
+
+        // shift the worse levels down, the last one falls off when the cache is full
+        for (int idx = std::min(count, DepthSnapshot::LEVELS - 1); idx > pos; --idx)
+            levels[idx] = levels[idx - 1];
+        levels[pos] = DepthLevel{ price, totalQty, orderCount };
+        if (count < DepthSnapshot::LEVELS)
+            ++count;
+        break;
     }
+    case LevelChange::UPDATE:
+        if (!cached)
+            return;
+        levels[pos].quantity_ = totalQty;
+        levels[pos].orderCount_ = orderCount;
+        break;
+    case LevelChange::REMOVE:
+    {
+        if (!cached)
+            return;
+
+        for (int idx = pos; idx < count - 1; ++idx)
+            levels[idx] = levels[idx + 1];
+        --count;
+
+        // a full cache pulls the next level of the book into the freed slot
+        if (count == DepthSnapshot::LEVELS - 1)
+        {
+            const BookSide<Side>& book = this->levels<Side>();
+            const OrderList* next = count ? book.next(book.find(levels[count - 1].price_)) : book.best();
+            if (next)
+                levels[count++] = DepthLevel{ next->price_, next->totalQty_, next->orderCount_ };
+        }
+        break;
+    }
+    }
+
+    depthDirty_ = true;
 }
 
-bool OrderBook::deleteFromSet(OrderPtr& orderPtr, char side)
+void OrderBook::saveSnapshot(std::ostream& os) const
 {
-    OrderListHashMap& orderListHashMap = (side == SIDE::BUY) ? bidOrderHashMap_ : offerOrderHashMap_;
-    OrderListHashMap::iterator iter = orderListHashMap.find(orderPtr->price_);
+    SnapshotBook book = {};
+    book.productId_ = productId_;
+    book.priceScale_ = priceScale_;
+    book.tickSize_ = bidLevels_.band().tickSize_;
+    book.minPrice_ = bidLevels_.band().minPrice_;
+    book.maxPrice_ = bidLevels_.band().maxPrice_;
+    book.lastTradedPrice_ = depth_.lastTradedPrice_;
+    book.lastTradedQty_ = depth_.lastTradedQty_;
+    book.matching_ = matching_ ? 1 : 0;
+    book.deltaSeqNo_ = deltaSeqNo_;
+    book.bidLevels_ = static_cast<uint32_t>(bidLevels_.size());
+    book.offerLevels_ = static_cast<uint32_t>(offerLevels_.size());
+    book.orderCount_ = orderPool_.size();
+    os.write(reinterpret_cast<const char*>(&book), sizeof(book));
 
-    if (iter != orderListHashMap.end())
+    auto writeLevels = [&os](const auto& side)
     {
-        iter->second->totalQty_ = iter->second->totalQty_ - orderPtr->quantity_; // reduce the quantity of the order from totalQty
-        iter->second->orderList_.remove(orderPtr);
+        for (const OrderList* level = side.best(); level; level = side.next(level))
+        {
+            const SnapshotLevel record{ level->price_, level->totalQty_, level->orderCount_ };
+            os.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        }
+    };
+    writeLevels(bidLevels_);
+    writeLevels(offerLevels_);
 
-        if (iter->second->totalQty_ == 0) // remove the empty orderListPtr from the set
+    auto writeOrders = [&os](const auto& side)
+    {
+        for (const OrderList* level = side.best(); level; level = side.next(level))
         {
-            if (side == SIDE::BUY)
-                bidSet_.erase(iter->second);
-            else
-                offerSet_.erase(iter->second);
+            for (const Order* order = level->head_; order; order = order->next_)
+            {
+                const SnapshotOrder record{ order->id_, order->quantity_ };
+                os.write(reinterpret_cast<const char*>(&record), sizeof(record));
+            }
+        }
+    };
+    writeOrders(bidLevels_);
+    writeOrders(offerLevels_);
+}
+
+bool OrderBook::loadSnapshot(const SnapshotBook& book, const SnapshotLevel* levels, const SnapshotOrder* orders)
+{
+    if (!bidLevels_.empty() || !offerLevels_.empty())
+        return false;
+
+    SeqCount::WriteScope update(orderIndex_.version());
+
+    orderPool_.reserve(book.orderCount_);
+    orderIndex_.reserve(orderIndex_.size() + book.orderCount_);
+    bidLevels_.reserveLevels(book.bidLevels_);
+    offerLevels_.reserveLevels(book.offerLevels_);
+
+    if (!loadSide<SIDE::BUY>(levels, book.bidLevels_, orders) || !loadSide<SIDE::SELL>(levels + book.bidLevels_, book.offerLevels_, orders))
+        return false;
+
+    depth_.lastTradedPrice_ = book.lastTradedPrice_;
+    depth_.lastTradedQty_ = book.lastTradedQty_;
+    deltaSeqNo_ = book.deltaSeqNo_;
+
+    finishLoad();
+    return true;
+}
+
+bool OrderBook::bulkLoad(std::span<const RestingOrder> orders)
+{
+    if (!bidLevels_.empty() || !offerLevels_.empty())
+        return false;
+
+    // counting sort on the price, a price level holds many orders. count the orders of every price
+    // while checking the records, then place each one behind those of its price already placed so the
+    // range order holds within a price
+    FlatHashMap<Price, size_t> bidPlaces;
+    FlatHashMap<Price, size_t> offerPlaces;
+    for (const RestingOrder& record : orders)
+    {
+        if (record.id_ <= 0 || record.quantity_ <= 0 || record.price_ <= 0 || (record.side_ != SIDE::BUY && record.side_ != SIDE::SELL))
+            return false;
+        if (!bidLevels_.isValidPrice(record.price_) || orderIndex_.contains(record.id_))
+            return false;
+        ++((record.side_ == SIDE::BUY) ? bidPlaces : offerPlaces)[record.price_];
+    }
 
-            orderListHashMap.erase(iter); // remove the element off the hashmap too since no quantity ..
+    const size_t bidCount = layoutPrices<SIDE::BUY>(bidPlaces, 0);
+    layoutPrices<SIDE::SELL>(offerPlaces, bidCount);
+
+    std::vector<size_t> sorted(orders.size());
+    for (size_t pos = 0; pos < orders.size(); ++pos)
+        sorted[((orders[pos].side_ == SIDE::BUY) ? bidPlaces : offerPlaces)[orders[pos].price_]++] = pos;
+
+    {
+        SeqCount::WriteScope update(orderIndex_.version());
+
+        orderPool_.reserve(orders.size());
+        orderIndex_.reserve(orderIndex_.size() + orders.size());
+
+        std::vector<Order*> created;
+        created.reserve(orders.size());
+        // orders are created in book order, so the orders of a level sit next to each other in the pool
+        for (size_t pos : sorted)
+        {
+            const RestingOrder& record = orders[pos];
+            Order* order = orderPool_.create(record.id_, record.quantity_);
+            if (!orderIndex_.emplace(order->id_, OrderHandle{ order, this }).second)
+            {
+                // an id repeated within the range, back out the orders created so far
+                orderPool_.destroy(order);
+                for (Order* added : created)
+                {
+                    orderIndex_.erase(added->id_);
+                    orderPool_.destroy(added);
+                }
+                return false;
+            }
+            created.push_back(order);
         }
 
-        return true;
+        const std::span<const size_t> places(sorted);
+        buildSide<SIDE::BUY>(orders, places.first(bidCount), created.data());
+        buildSide<SIDE::SELL>(orders, places.subspan(bidCount), created.data() + bidCount);
+
+        finishLoad();
     }
 
-    return false;
-}
-
-void OrderBook::getLastTradeDetails(double& price, int& quantity) const
-{
-    price = lastTradedPrice_;
-    quantity = lastTradedQuantity_;
+    // unlike a snapshot the load is not a state the depth consumers can resync from, so every level it
+    // opened goes out as an ADD, best first, numbered after the deltas already sent
+    for (const OrderList* level = bidLevels_.best(); level; level = bidLevels_.next(level))
+        publishLevelChange<SIDE::BUY>(LevelChange::ADD, level->price_, level->totalQty_, level->orderCount_);
+    for (const OrderList* level = offerLevels_.best(); level; level = offerLevels_.next(level))
+        publishLevelChange<SIDE::SELL>(LevelChange::ADD, level->price_, level->totalQty_, level->orderCount_);
+    return true;
+}
+
+// queue the orders of a side level by level. places are the positions of its records sorted best price
+// first and created the order made for each of them. each level is opened once at the worst end of the side
+template<char Side>
+void OrderBook::buildSide(std::span<const RestingOrder> records, std::span<const size_t> places, Order* const* created)
+{
+    BookSide<Side>& book = levels<Side>();
+
+    size_t levelCount = 0;
+    for (size_t idx = 0; idx < places.size(); ++idx)
+    {
+        if (!idx || records[places[idx]].price_ != records[places[idx - 1]].price_)
+            ++levelCount;
+    }
+    book.reserveLevels(levelCount);
+
+    OrderList* level = nullptr;
+    for (size_t idx = 0; idx < places.size(); ++idx)
+    {
+        const Price price = records[places[idx]].price_;
+        if (!level || level->price_ != price)
+            level = book.appendLevel(price);
+        level->pushBack(created[idx], Side);
+    }
+}
+
+// a bulk built book skipped the per level updates, bring the cumulative depth and the top levels in line
+void OrderBook::finishLoad()
+{
+    bidLevels_.reindex();
+    offerLevels_.reindex();
+    rebuildDepth();
+    publishDepth();
+}
+
+// levels come best first, each one opened once at the worst end of the side and filled in time priority
+template<char Side>
+bool OrderBook::loadSide(const SnapshotLevel* levels, size_t levelCount, const SnapshotOrder*& orders)
+{
+    BookSide<Side>& book = this->levels<Side>();
+
+    for (size_t idx = 0; idx < levelCount; ++idx)
+    {
+        const SnapshotLevel& record = levels[idx];
+        if (record.orderCount_ <= 0 || !book.isValidPrice(record.price_))
+            return false;
+        if (idx && !BookSide<Side>::isBetter(levels[idx - 1].price_, record.price_))
+            return false;
+
+        OrderList* level = book.appendLevel(record.price_);
+        if (!level)
+            return false;
+
+        for (int count = 0; count < record.orderCount_; ++count, ++orders)
+        {
+            if (orders->id_ <= 0 || orders->quantity_ <= 0)
+                return false;
+
+            Order* order = orderPool_.create(orders->id_, orders->quantity_);
+            if (!orderIndex_.emplace(order->id_, OrderHandle{ order, this }).second)
+            {
+                orderPool_.destroy(order);
+                return false;
+            }
+            level->pushBack(order, Side);
+        }
+
+        if (level->totalQty_ != record.totalQty_)
+            return false;
+    }
+
+    return true;
+}
+
+// fill the cached top levels from scratch after a bulk build
+void OrderBook::rebuildDepth()
+{
+    depth_.bidCount_ = 0;
+    for (const OrderList* level = bidLevels_.best(); level && depth_.bidCount_ < DepthSnapshot::LEVELS; level = bidLevels_.next(level))
+        depth_.bids_[depth_.bidCount_++] = DepthLevel{ level->price_, level->totalQty_, level->orderCount_ };
+
+    depth_.offerCount_ = 0;
+    for (const OrderList* level = offerLevels_.best(); level && depth_.offerCount_ < DepthSnapshot::LEVELS; level = offerLevels_.next(level))
+        depth_.offers_[depth_.offerCount_++] = DepthLevel{ level->price_, level->totalQty_, level->orderCount_ };
+
+    depthDirty_ = true;
+}
+
+void OrderBook::getLastTradeDetails(Price& price, int& quantity) const
+{
+    const DepthSnapshot depth = getDepth();
+    price = depth.lastTradedPrice_;
+    quantity = depth.lastTradedQty_;
+}
+
+bool OrderBook::getPriceForQuantity(char side, int quantity, Price& price) const
+{
+    return (side == SIDE::BUY) ? bidLevels_.priceForQuantity(quantity, price) : offerLevels_.priceForQuantity(quantity, price);
+}
+
+bool OrderBook::getVwapForQuantity(char side, int quantity, double& vwap) const
+{
+    int64_t notional;
+    if (!((side == SIDE::BUY) ? bidLevels_.notionalForQuantity(quantity, notional) : offerLevels_.notionalForQuantity(quantity, notional)))
+        return false;
+
+    vwap = static_cast<double>(notional) / quantity;
+    return true;
+}
+
+int64_t OrderBook::getQuantityWithin(char side, Price distance) const
+{
+    if (side == SIDE::BUY)
+        return bidLevels_.empty() ? 0 : bidLevels_.quantityWithin(bidLevels_.best()->price_ - distance);
+    return offerLevels_.empty() ? 0 : offerLevels_.quantityWithin(offerLevels_.best()->price_ + distance);
+}
+
+bool OrderBook::getQueuePosition(int id, int& ordersAhead, int& quantityAhead) const
+{
+    auto iter = orderIndex_.find(id);
+    if (iter == orderIndex_.end() || iter->second.book_ != this)
+        return false;
+
+    // walk both ways in step and stop at the nearer end of the queue. from the back, what is ahead is
+    // what the level holds minus the order and what is behind it
+    const Order* order = iter->second.order_;
+    const OrderList* level = order->level();
+    int countAhead = 0, qtyAhead = 0, countBehind = 0, qtyBehind = 0;
+    for (const Order *ahead = order->prev_, *behind = order->next_;; ahead = ahead->prev_, behind = behind->next_)
+    {
+        if (!ahead)
+        {
+            ordersAhead = countAhead;
+            quantityAhead = qtyAhead;
+            return true;
+        }
+        if (!behind)
+        {
+            ordersAhead = level->orderCount_ - 1 - countBehind;
+            quantityAhead = level->totalQty_ - order->quantity_ - qtyBehind;
+            return true;
+        }
+
+        ++countAhead;
+        qtyAhead += ahead->quantity_;
+        ++countBehind;
+        qtyBehind += behind->quantity_;
+    }
+}
+
+MemoryUsage OrderBook::memoryUsage() const
+{
+    MemoryUsage usage;
+    usage.orders_ = orderPool_.memoryUsage();
+    usage.levels_ = bidLevels_.levelMemoryUsage() + offerLevels_.levelMemoryUsage();
+    usage.indices_ = bidLevels_.indexMemoryUsage() + offerLevels_.indexMemoryUsage() + ownOrderIndex_.memoryUsage();
+    usage.books_ = sizeof(OrderBook);
+    return usage;
 }
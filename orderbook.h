@@ -1,119 +1,246 @@
-#pragma once
-
-#include <memory>
-#include <unordered_map>
-#include <iostream>
-#include <vector>
-#include <list>
-#include <map>
-#include <set>
-
-namespace SIDE
-{
-	const char BUY = 'B';
-	const char SELL = 'S';
-}
-
-struct Order
-{
-	int id_;
-	char side_;
-	double price_;
-	int quantity_;
-
-	Order(int id, char side, double price, int quantity) :id_(id), side_(side), price_(price), quantity_(quantity)
-	{
-	}
-};
-
-typedef std::shared_ptr<Order> OrderPtr;
-
-// maintain an orderlist based on the price it holds.
-struct OrderList
-{
-    double price_;
-    int totalQty_;
-    std::list<OrderPtr> orderList_;
-
-    OrderList(OrderPtr& orderPtr) :price_(orderPtr->price_), totalQty_(orderPtr->quantity_)
-    {
-        orderList_.push_back(orderPtr);
-    }
-};
-
-typedef std::shared_ptr<OrderList> OrderListPtr;
-
-/*
- * @brief : OrderBook is the class to maintain and manage the orders
- * for a particular instrument.
- */
-class OrderBook
-{
-private:
-    const int productId_;
-
-    struct AscendCompare
-    {
-        bool operator() (const OrderListPtr& OLP1, const OrderListPtr& OLP2) const
-        {
-            return comparator(OLP1->price_, OLP2->price_);
-        }
-
-        std::greater<double> comparator;
-    };
-
-    struct DescendCompare
-    {
-        bool operator() (const OrderListPtr& OLP1, const OrderListPtr& OLP2) const
-        {
-            return comparator(OLP1->price_, OLP2->price_);
-        }
-
-        std::less<double> comparator;
-    };
-
-    // store id to orderPtr hash map for constant time lookup of order based on id's
-    typedef std::unordered_map<int, OrderPtr> OrderIdHashMap;
-
-    // have a set to maintain distinct sorted price
-    typedef std::set<OrderListPtr, AscendCompare> AscendOrderSet;
-    typedef std::set<OrderListPtr, DescendCompare> DescendOrderSet;
-
-    // store price to orderlist hash map for constant time lookup for existing price
-    typedef std::unordered_map<double, OrderListPtr> OrderListHashMap;
-
-    AscendOrderSet bidSet_; // will be a max set to keep the best price on top
-    DescendOrderSet offerSet_; // will be a min set to keep the best ask price on top
-    OrderListHashMap bidOrderHashMap_;
-    OrderListHashMap offerOrderHashMap_;
-    OrderIdHashMap orderIdHashMap_;
-
-    int lastTradedQuantity_ = 0;
-    double lastTradedPrice_ = 0.0;
-
-    // do not copy
-    OrderBook(const OrderBook&) = delete;
-    OrderBook& operator=(const OrderBook&) = delete;
-
-    void addOrUpdateSet(OrderPtr& orderPtr, char side);
-    bool deleteFromSet(OrderPtr& orderPtr, char side);
-    void generateFills(const std::vector<int>& totalFills, const std::map<int, int>& partialFills);
-    bool checkIfValidTradeAndUpdateOrderBook(const double price, const int quantity);
-
-public:
-    explicit OrderBook(const int productId):productId_(productId) {}
-
-    void getLastTradeDetails(double& price, int& quantity) const;
-
-    ~OrderBook() {}
-
-    void enterOrder(int id, char side, double price, int quantity);
-    bool getOrderFromId(int id, Order& record);
-    bool modifyOrder(int id, int quantity);
-    bool deleteOrder(int id);
-    bool handleTrade(double price, int quantity);
-    void printOrderBook() const;
-    int getProductId() const { return productId_; }
-
-
-};
+#pragma once
+
+#include "pricelevels.h"
+#include "orderevents.h"
+#include "result.h"
+#include "flathashmap.h"
+#include "depth.h"
+#include "seqlock.h"
+#include "snapshot.h"
+#include "stats.h"
+#include <iostream>
+#include <span>
+#include <vector>
+
+// static reference data of an instrument
+struct ProductConfig
+{
+    int priceScale_ = PRICE::DEFAULT_SCALE; // number of decimals carried by the fixed point prices
+    PriceBand band_; // optional tick size and price band (in fixed point units)
+    bool matching_ = false; // match incoming orders against the book instead of resting them as a passive replica
+    size_t expectedOrders_ = 0; // sizing hint, the order pool and index are allocated for that many live orders up front
+
+    ProductConfig() = default;
+    ProductConfig(int priceScale, const PriceBand& band = PriceBand(), bool matching = false) :priceScale_(priceScale), band_(band), matching_(matching) {}
+};
+
+// bytes held by a book or a manager, allocated capacity included
+struct MemoryUsage
+{
+    size_t orders_ = 0;  // order slots
+    size_t levels_ = 0;  // price levels, whole ladders included
+    size_t indices_ = 0; // order index, level lookups, depth trees and the books lookup of a manager
+    size_t books_ = 0;   // the book objects themselves
+
+    size_t total() const { return orders_ + levels_ + indices_ + books_; }
+
+    MemoryUsage& operator+=(const MemoryUsage& rhs)
+    {
+        orders_ += rhs.orders_;
+        levels_ += rhs.levels_;
+        indices_ += rhs.indices_;
+        books_ += rhs.books_;
+        return *this;
+    }
+};
+
+class OrderBook;
+class DeltaRing;
+
+// where a live order sits. one entry per live order, dropped as soon as the order is filled or cancelled
+struct OrderHandle
+{
+    Order* order_ = nullptr;
+    OrderBook* book_ = nullptr;
+};
+
+// concurrent readers copy a handle out of the index field by field, see FlatHashMap::findShared
+template<>
+struct SharedValue<OrderHandle>
+{
+    static OrderHandle load(const OrderHandle& handle) { return OrderHandle{ relaxedLoad(handle.order_), relaxedLoad(handle.book_) }; }
+    static void store(OrderHandle& slot, const OrderHandle& handle)
+    {
+        relaxedStore(slot.order_, handle.order_);
+        relaxedStore(slot.book_, handle.book_);
+    }
+};
+
+// one resting order as loaded in bulk or looked up, price in the fixed point units of the book
+struct RestingOrder
+{
+    int id_;
+    char side_;
+    Price price_;
+    int quantity_;
+};
+
+/*
+ * @brief : order id to handle index, either private to a book or shared by all
+ * the books of a manager. The books move its version around each update of the
+ * index or of the orders it points to, so once shared reads are enabled a
+ * reader on another thread looks orders up optimistically and retries when an
+ * update ran in between. Orders live in pool slots that stay allocated with
+ * their book, so a stale handle is still safe to read.
+ */
+class OrderIndex : public FlatHashMap<int, OrderHandle>
+{
+private:
+    SeqCount version_;
+
+public:
+    OrderIndex() = default;
+    explicit OrderIndex(size_t expected) :FlatHashMap<int, OrderHandle>(expected) {}
+
+    SeqCount& version() { return version_; }
+    const SeqCount& version() const { return version_; }
+};
+
+/*
+ * @brief : OrderBook is the class to maintain and manage the orders
+ * for a particular instrument.
+ */
+class OrderBook
+{
+private:
+    const int productId_;
+    const int priceScale_;
+    const bool matching_;
+
+    ObjectPool<Order> orderPool_; // owns every resting order of the book
+
+    BidSide bidLevels_; // best (highest) bid price first
+    OfferSide offerLevels_; // best (lowest) ask price first
+
+    // id to order index for constant time lookup of order based on id's. order ids are unique across
+    // every book sharing the index, so a book only acts on the entries pointing back to it
+    OrderIndex ownOrderIndex_;
+    OrderIndex& orderIndex_;
+
+    OrderEventListener* listener_ = &OrderEventListener::null();
+
+    // top of both sides and the last trade kept up to date on every change, published to the readers once per operation
+    DepthSnapshot depth_;
+    SeqLock<DepthSnapshot> publishedDepth_;
+    bool depthDirty_ = false;
+
+    // every level change goes out as a LevelDelta when a ring is attached
+    DeltaRing* deltaRing_ = nullptr;
+    uint64_t deltaSeqNo_ = 0;
+
+    OB_STATS(BookCounters counters_;)
+
+    // do not copy
+    OrderBook(const OrderBook&) = delete;
+    OrderBook& operator=(const OrderBook&) = delete;
+
+    // the char side of a message is resolved once at the public entry points, everything below them
+    // works on the typed side
+    template<char Side> BookSide<Side>& levels() { if constexpr (Side == SIDE::BUY) return bidLevels_; else return offerLevels_; }
+    static constexpr char opposite(char side) { return (side == SIDE::BUY) ? SIDE::SELL : SIDE::BUY; }
+
+    template<char Side> Result enterSide(int id, Price price, int quantity, char orderType);
+    OrderIndex::iterator findOrder(int id);
+    template<char Side> void eraseOrder(OrderIndex::iterator iter);
+    template<char Side> void notifyLevelChange(LevelChange change, Price price, int totalQty, int orderCount);
+    template<char Side> void publishLevelChange(LevelChange change, Price price, int totalQty, int orderCount);
+    template<char Side> void updateDepth(LevelChange change, Price price, int totalQty, int orderCount);
+    void publishDepth() { if (depthDirty_) { publishedDepth_.store(depth_); depthDirty_ = false; } }
+    void rebuildDepth();
+    template<char Side> bool loadSide(const SnapshotLevel* levels, size_t levelCount, const SnapshotOrder*& orders);
+    template<char Side> void buildSide(std::span<const RestingOrder> records, std::span<const size_t> places, Order* const* created);
+    void finishLoad();
+    template<char Side> int matchOrder(int id, Price price, int quantity, char orderType);
+    void recordTrade(Price price, int quantity);
+    template<char Side> void fillOrder(Order* order, int fillQty);
+    template<char Side> void consume(int quantity);
+    Result checkIfValidTradeAndUpdateOrderBook(const Price price, const int quantity) noexcept;
+
+public:
+    // a book indexes its orders on its own unless given the index it shares with other books, which has to outlive it
+    explicit OrderBook(const int productId, const ProductConfig& config = ProductConfig(), OrderIndex* sharedIndex = nullptr)
+        :productId_(productId), priceScale_(config.priceScale_), matching_(config.matching_), bidLevels_(config.band_), offerLevels_(config.band_),
+        orderIndex_(sharedIndex ? *sharedIndex : ownOrderIndex_)
+    {
+        if (config.expectedOrders_)
+        {
+            orderPool_.reserve(config.expectedOrders_);
+            if (!sharedIndex)
+                ownOrderIndex_.reserve(config.expectedOrders_);
+        }
+    }
+
+    ~OrderBook() {}
+
+    // one thread applies the operations below. with concurrent readers enabled getOrderFromId, getLastTradeDetails,
+    // printOrderBook and getDepth are safe from any other thread as well and never hold the writer up. they
+    // read published copies or retry while an update runs, the readers of a shared index enable it on the manager.
+    // a retry lasts as long as the stores of an update, listeners are called outside of them
+    void enableConcurrentReaders() { orderIndex_.enableSharedReads(); }
+
+    // hot path operations report expected rejects through the returned result, they never throw.
+    // on a matching book the order first trades against the other side and only a limit order rests its remainder
+    Result enterOrder(int id, char side, Price price, int quantity, char orderType = ORDERTYPE::LIMIT) noexcept;
+    bool getOrderFromId(int id, RestingOrder& record) const;
+    void getLastTradeDetails(Price& price, int& quantity) const;
+    Result modifyOrder(int id, int quantity) noexcept;
+    Result deleteOrder(int id) noexcept;
+    // same on an order already looked up in the index, which has to point to this book
+    Result modifyOrder(OrderIndex::iterator handle, int quantity) noexcept;
+    Result deleteOrder(OrderIndex::iterator handle) noexcept;
+    Result handleTrade(Price price, int quantity) noexcept;
+    // top 5 levels of both sides as of the last completed operation
+    void printOrderBook() const;
+
+    // resting orders, levels, last trade and delta sequence in the snapshot layout of snapshot.h
+    void saveSnapshot(std::ostream& os) const;
+    // bulk build an empty book from its snapshot records, levels at once and orders straight into them.
+    // false when the records do not hold together, the book is then unusable
+    bool loadSnapshot(const SnapshotBook& book, const SnapshotLevel* levels, const SnapshotOrder* orders);
+    // bulk build an empty book from resting orders in any price order, such as an exchange start of day
+    // snapshot. orders of a price queue in the order of the range. every record is checked up front and
+    // the book is left untouched when one is invalid or an id is taken. the orders rest as given, a
+    // matching book does not match them, and no order events go out. each level loaded goes out as an
+    // ADD level change and delta, so depth consumers attached ahead of the load follow it
+    bool bulkLoad(std::span<const RestingOrder> orders);
+
+    // copy of the top levels as of the last completed operation. safe to call from any thread, never blocks the writer
+    DepthSnapshot getDepth() const { return publishedDepth_.load(); }
+
+    // depth queries on the resting orders of one side, so the cost of buying looks at the SELL side. served
+    // from cumulative trees on a ladder book in log n, by walking the levels involved otherwise. they read
+    // the live book, from the thread applying the messages
+    // worst price reached sweeping quantity off the side. false when the side holds less
+    bool getPriceForQuantity(char side, int quantity, Price& price) const;
+    // volume weighted average price of that sweep, in the fixed point units of the book's prices
+    bool getVwapForQuantity(char side, int quantity, double& vwap) const;
+    // quantity resting within distance of the best price of the side, best level included. N ticks is N * tickSize
+    int64_t getQuantityWithin(char side, Price distance) const;
+    // orders and quantity queued ahead of an order at its price level. not sub linear : it walks from the order
+    // to the nearer end of its queue, so it costs the distance to the front or the back, whichever is shorter.
+    // an order in the middle of a long queue costs half the queue. an order statistics tree per level would
+    // get it to log n but cost every add, cancel and fill more than the lookup saves
+    bool getQueuePosition(int id, int& ordersAhead, int& quantityAhead) const;
+    // the order index is counted here only when the book has its own, a shared one goes to the manager
+    MemoryUsage memoryUsage() const;
+    int getProductId() const { return productId_; }
+    int getPriceScale() const { return priceScale_; }
+    bool isMatching() const { return matching_; }
+
+    // events go to the null listener unless one is set. the listener has to outlive the book
+    void setEventListener(OrderEventListener* listener) { listener_ = listener ? listener : &OrderEventListener::null(); }
+
+    // level deltas go out on the ring (nullptr to stop). deltas are numbered from the first level change of the book on,
+    // attached or not, so a consumer can tell whether it has seen them all
+    void setDeltaRing(DeltaRing* ring) { deltaRing_ = ring; }
+    uint64_t getDeltaSeqNo() const { return deltaSeqNo_; }
+
+    // levels opened and emptied and the peak depth of each side, zero when built with OB_DISABLE_STATS
+#ifndef OB_DISABLE_STATS
+    const BookCounters& getCounters() const { return counters_; }
+#else
+    BookCounters getCounters() const { return BookCounters(); }
+#endif
+
+
+};
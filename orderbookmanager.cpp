@@ -1,207 +1,551 @@
-#include "orderbookmanager.h"
-#include <regex>
-
-std::vector<std::string> tokenize(
-	const std::string& str,
-	const std::regex re)
-{
-	std::sregex_token_iterator begin(str.begin(), str.end(), re, -1), end;
-	std::vector<std::string> tokenized{ begin, end };
-
-	// Additional check to remove empty strings 
-	tokenized.erase(
-		std::remove_if(tokenized.begin(),
-			tokenized.end(),
-			[](std::string const& s) {
-				return s.size() == 0;
-			}),
-		tokenized.end());
-
-	return tokenized;
-}
-
-void OrderBookManager::sanitizeInputs(int productId, int orderId, char side, int quantity, double price)
-{
-	if (productId <= 0)
-		throw std::runtime_error("Received invalid productId");
-
-	if (orderId <= 0)
-		throw std::runtime_error("Received invalid orderId");
-
-	if (side != SIDE::BUY && side != SIDE::SELL)
-		throw std::runtime_error("Invalid Side received");
-
-	if (quantity <= 0 || price <= 0)
-		throw std::runtime_error("Invalid price/quantity received");
-}
-
-
-void OrderBookManager::sanitizeInputs(int orderId, char side, int quantity, double price)
-{
-	if (orderId <= 0)
-		throw std::runtime_error("Received invalid orderId");
-
-	if (side != SIDE::BUY && side != SIDE::SELL)
-		throw std::runtime_error("Invalid Side received");
-
-	if (quantity <= 0 || price <= 0)
-		throw std::runtime_error("Invalid price/quantity received");
-}
-
-void OrderBookManager::sanitizeInputs(int productId, int quantity, double price)
-{
-	if (productId <= 0)
-		throw std::runtime_error("Received invalid productId");
-
-	if (quantity <= 0 || price <= 0)
-		throw std::runtime_error("Invalid price/quantity received");
-}
-
-// take actions as per the orderbook for the productId (look up orderbook from orderId if productId not already available)
-void OrderBookManager::action(const char action, int productId, int orderId, char side, int quantity, double price)
-{
-	try {
-		switch (action)
-		{
-		case ACTION::NEW:
-		{
-			// sanitize the received inputs
-			sanitizeInputs(productId, orderId, side, quantity, price);
-
-			// check if orderId already exists
-			if (ordIdToOrderBook_.find(orderId) != ordIdToOrderBook_.end())
-				throw std::runtime_error("OrderId already exists!!!");
-
-			auto op = prdIdToOrderBook_.emplace(productId, productId);
-			// add new order now
-			op.first->second.enterOrder(orderId, side, price, quantity);
-
-			ordIdToOrderBook_.emplace(orderId, op.first);
-			break;
-		}
-		case ACTION::MODIFY:
-		{
-			// sanitize the received inputs
-			sanitizeInputs(orderId, side, quantity, price);
-
-			// check if orderId already exists
-			auto op = ordIdToOrderBook_.find(orderId);
-			if (op == ordIdToOrderBook_.end())
-				throw std::runtime_error("OrderId not available!!!");
-
-			auto& ob = op->second->second;
-			if (!ob.modifyOrder(orderId, quantity))
-				throw std::runtime_error("Failed modifying order");
-			break;
-		}
-		case ACTION::REMOVE:
-		{
-			// sanitize the received inputs
-			sanitizeInputs(orderId, side, quantity, price);
-
-			// check if orderId already exists
-			auto op = ordIdToOrderBook_.find(orderId);
-			if (op == ordIdToOrderBook_.end())
-				throw std::runtime_error("OrderId not available!!!");
-
-			auto& ob = op->second->second;
-			if (!ob.deleteOrder(orderId))
-				throw std::runtime_error("Failed deleting order");
-			break;
-		}
-		case ACTION::TRADE:
-		{
-			// sanitize the received inputs
-			sanitizeInputs(productId, quantity, price);
-			auto it = prdIdToOrderBook_.find(productId);
-
-			auto& ob = it->second;
-			ob.handleTrade(price, quantity);
-
-			break;
-		}
-		default:
-			throw std::runtime_error("Invalid Action provided!!");
-		}
-	}
-	catch (std::exception& ex)
-	{
-		exceptions_.emplace_back(ex.what(), orderId);
-	}
-}
-
-void OrderBookManager::action(const std::string& msg)
-{
-	try {
-		const std::regex re(R"([,;: ])");
-		std::vector<std::string> cmds = tokenize(msg, re);
-		const char cmd = (cmds.at(0)).at(0);
-
-		switch (cmd)
-		{
-		case ACTION::NEW:
-			if (cmds.size() != 6)
-				throw std::runtime_error("Invalid arguments for new order");
-			action(cmd, std::stoi(cmds.at(1)), std::stoi(cmds.at(2)), (cmds.at(3)).at(0), std::stoi(cmds.at(4)), std::stod(cmds.at(5)));
-			break;
-		case ACTION::MODIFY:
-		case ACTION::REMOVE:
-			if (cmds.size() != 5)
-				throw std::runtime_error("Invalid arguments for modify/cancel order");
-			action(cmd, 0, std::stoi(cmds.at(1)), (cmds.at(2)).at(0), std::stoi(cmds.at(3)), std::stod(cmds.at(4)));
-			break;
-		case ACTION::TRADE: // trade
-			if (cmds.size() != 4)
-				throw std::runtime_error("Invalid arguments for trade");
-			action(cmd, std::stoi(cmds.at(1)), 0, 0, std::stoi(cmds.at(2)), std::stod(cmds.at(3)));
-			break;
-		default:
-			throw std::runtime_error("Invalid Action provided!!");
-		}
-	}
-	catch (std::exception& ex)
-	{
-		exceptions_.emplace_back(ex.what(), 0);
-	}
-}
-
-void OrderBookManager::printOB(const int productId/* = 0*/)
-{
-	int quantity;
-	double price;
-
-	if (!productId)
-	{
-		// print the orderbook for all the existing orderbooks
-		for (const auto& elem : prdIdToOrderBook_)
-		{
-			std::cout << "ProductId [" << elem.first << "]" << std::endl;
-			elem.second.printOrderBook();
-
-			elem.second.getLastTradeDetails(price, quantity);
-			std::cout << "Last Traded Price [" << price << "] Last Traded Quantity [" << quantity << "]" << std::endl;
-		}
-	}
-	else
-	{
-		std::cout << "ProductId [" << productId << "]" << std::endl;
-		auto ob = prdIdToOrderBook_.find(productId);
-		if (ob == prdIdToOrderBook_.end())
-			throw std::runtime_error("OrderBook doesn't exists for productId");
-		ob->second.printOrderBook();
-
-		ob->second.getLastTradeDetails(price, quantity);
-		std::cout << "Last Traded Price [" << price << "] Last Traded Quantity [" << quantity << "]" << std::endl;
-	}
-}
-
-void OrderBookManager::printExceptions()
-{
-	for (const auto& elem : exceptions_)
-	{
-		if (elem.id_)
-			std::cout << "OrderId [" << elem.id_ << "] msg [" << elem.msg_ << "]" << std::endl;
-		else
-			std::cout << "Msg parsing failed with error [" << elem.msg_ << "]" << std::endl;
-	}
+#include "orderbookmanager.h"
+#include "mappedfile.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// flush a written file, or the entries of a directory, to disk
+#ifdef _WIN32
+	bool syncPath(const std::string& path)
+	{
+		const int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+		if (fd < 0)
+			return false;
+		const bool synced = _commit(fd) == 0;
+		_close(fd);
+		return synced;
+	}
+
+	// NTFS journals the rename itself, there is no directory to sync
+	bool syncDir(const std::string&) { return true; }
+#else
+	bool syncPath(const std::string& path)
+	{
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		const bool synced = fsync(fd) == 0;
+		::close(fd);
+		return synced;
+	}
+
+	bool syncDir(const std::string& path)
+	{
+		const size_t slash = path.find_last_of('/');
+		return syncPath((slash == std::string::npos) ? std::string(".") : (slash == 0) ? std::string("/") : path.substr(0, slash));
+	}
+#endif
+}
+
+OrderBookManager::OrderBookManager(size_t expectedOrders, int denseProductIds) :orderIndex_(expectedOrders), denseProductIds_(std::max(denseProductIds, 0))
+{
+}
+
+Result OrderBookManager::sanitizeInputs(int productId, int orderId, char side, int quantity, Price price, char orderType) noexcept
+{
+	if (productId <= 0)
+		return Result::INVALID_PRODUCT_ID;
+
+	// market orders take whatever the other side offers, their price is not used
+	if (orderType == ORDERTYPE::MARKET && price == 0)
+		price = 1;
+
+	return sanitizeInputs(orderId, side, quantity, price);
+}
+
+Result OrderBookManager::sanitizeInputs(int orderId, char side, int quantity, Price price) noexcept
+{
+	if (orderId <= 0)
+		return Result::INVALID_ORDER_ID;
+
+	if (side != SIDE::BUY && side != SIDE::SELL)
+		return Result::INVALID_SIDE;
+
+	if (quantity <= 0 || price <= 0)
+		return Result::INVALID_PRICE_QTY;
+
+	return Result::OK;
+}
+
+Result OrderBookManager::sanitizeInputs(int productId, int quantity, Price price) noexcept
+{
+	if (productId <= 0)
+		return Result::INVALID_PRODUCT_ID;
+
+	if (quantity <= 0 || price <= 0)
+		return Result::INVALID_PRICE_QTY;
+
+	return Result::OK;
+}
+
+void OrderBookManager::configureProduct(int productId, const ProductConfig& config)
+{
+	if (productId <= 0)
+		throw std::runtime_error("Received invalid productId");
+
+	if (config.priceScale_ < 0 || config.priceScale_ > PRICE::MAX_SCALE)
+		throw std::runtime_error("Invalid price scale received");
+
+	if (!config.band_.isValid())
+		throw std::runtime_error("Invalid price band received");
+
+	if (findBook(productId))
+		throw std::runtime_error("OrderBook already exists for productId");
+
+	if (booksFrozen_)
+		throw std::runtime_error("Books have to be configured before concurrent readers are enabled");
+
+	addBook(productId, config);
+}
+
+void OrderBookManager::setEventListener(OrderEventListener* listener)
+{
+	listener_ = listener;
+	for (auto& book : books_)
+		book->setEventListener(listener_);
+}
+
+void OrderBookManager::setDeltaRing(DeltaRing* ring)
+{
+	deltaRing_ = ring;
+	for (auto& book : books_)
+		book->setDeltaRing(deltaRing_);
+}
+
+OrderBook* OrderBookManager::findBook(int productId) const
+{
+	if (productId >= 0 && productId < static_cast<int>(denseBooks_.size()))
+		return denseBooks_[productId];
+
+	if (productId < denseProductIds_)
+		return nullptr;
+
+	auto it = sparseBooks_.find(productId);
+	return (it != sparseBooks_.end()) ? it->second : nullptr;
+}
+
+OrderBook& OrderBookManager::addBook(int productId, const ProductConfig& config)
+{
+	return addBook(std::unique_ptr<OrderBook>(new OrderBook(productId, config, &orderIndex_)));
+}
+
+OrderBook& OrderBookManager::addBook(std::unique_ptr<OrderBook> created)
+{
+	// keep the books sorted on the product id, new products are rare
+	const int productId = created->getProductId();
+	auto pos = std::upper_bound(books_.begin(), books_.end(), productId, [](int id, const std::unique_ptr<OrderBook>& book) { return id < book->getProductId(); });
+	OrderBook* book = books_.emplace(pos, std::move(created))->get();
+	book->setEventListener(listener_);
+	book->setDeltaRing(deltaRing_);
+
+	if (productId < denseProductIds_)
+	{
+		if (productId >= static_cast<int>(denseBooks_.size()))
+			denseBooks_.resize(static_cast<size_t>(productId) + 1, nullptr);
+		denseBooks_[productId] = book;
+	}
+	else
+		sparseBooks_.emplace(productId, book);
+
+	return *book;
+}
+
+void OrderBookManager::clearBooks()
+{
+	orderIndex_.clear();
+	denseBooks_.clear();
+	sparseBooks_.clear();
+	books_.clear();
+}
+
+bool OrderBookManager::saveSnapshot(const std::string& path) const
+{
+	// written aside, synced and renamed into place, then the rename is synced, so a crash or a power loss
+	// leaves either the previous snapshot or the whole new one behind
+	const std::string tmpPath = path + ".tmp";
+	{
+		std::ofstream os(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!os.is_open())
+			return false;
+
+		const SnapshotHeader header = SnapshotHeader::make(static_cast<uint32_t>(books_.size()), lastSeqNo_);
+		os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		for (const auto& book : books_)
+			book->saveSnapshot(os);
+
+		if (!os.flush())
+			return false;
+	}
+
+	if (!syncPath(tmpPath) || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+		return false;
+
+	return syncDir(path);
+}
+
+bool OrderBookManager::loadSnapshot(const std::string& path)
+{
+	if (!books_.empty() || booksFrozen_)
+		return false;
+
+	MappedFile file;
+	if (!file.open(path))
+		return false;
+
+	if (!loadBooks(file.data(), file.data() + file.size()))
+	{
+		clearBooks();
+		return false;
+	}
+
+	return true;
+}
+
+bool OrderBookManager::bulkLoad(int productId, std::span<const RestingOrder> orders)
+{
+	if (productId <= 0)
+		return false;
+
+	OrderBook* book = findBook(productId);
+	if (book)
+		return book->bulkLoad(orders);
+	if (booksFrozen_)
+		return false;
+
+	// a new book is only added once its load went through, a refused load leaves no book behind
+	std::unique_ptr<OrderBook> loaded(new OrderBook(productId, ProductConfig(), &orderIndex_));
+	loaded->setEventListener(listener_);
+	loaded->setDeltaRing(deltaRing_);
+	if (!loaded->bulkLoad(orders))
+		return false;
+
+	addBook(std::move(loaded));
+	return true;
+}
+
+// records are read in place, the mapping is page aligned and every record keeps 8 byte alignment
+bool OrderBookManager::loadBooks(const char* data, const char* end)
+{
+	if (static_cast<size_t>(end - data) < sizeof(SnapshotHeader))
+		return false;
+
+	const SnapshotHeader& header = *reinterpret_cast<const SnapshotHeader*>(data);
+	if (!header.isValid())
+		return false;
+	data += sizeof(SnapshotHeader);
+
+	for (uint32_t idx = 0; idx < header.bookCount_; ++idx)
+	{
+		if (static_cast<size_t>(end - data) < sizeof(SnapshotBook))
+			return false;
+		const SnapshotBook& book = *reinterpret_cast<const SnapshotBook*>(data);
+		data += sizeof(SnapshotBook);
+
+		const size_t levelCount = static_cast<size_t>(book.bidLevels_) + book.offerLevels_;
+		if (static_cast<size_t>(end - data) / sizeof(SnapshotLevel) < levelCount)
+			return false;
+		const SnapshotLevel* levels = reinterpret_cast<const SnapshotLevel*>(data);
+		data += levelCount * sizeof(SnapshotLevel);
+
+		// the level order counts have to add up before any order is read
+		uint64_t orderCount = 0;
+		for (size_t level = 0; level < levelCount; ++level)
+			orderCount += static_cast<uint64_t>(std::max(levels[level].orderCount_, 0));
+		if (orderCount != book.orderCount_ || static_cast<uint64_t>(end - data) / sizeof(SnapshotOrder) < orderCount)
+			return false;
+		const SnapshotOrder* orders = reinterpret_cast<const SnapshotOrder*>(data);
+		data += orderCount * sizeof(SnapshotOrder);
+
+		if (book.productId_ <= 0 || findBook(book.productId_) || book.priceScale_ < 0 || book.priceScale_ > PRICE::MAX_SCALE)
+			return false;
+
+		// a band wider than a ladder loads sparse, a corrupt one is refused before anything is allocated for it
+		ProductConfig config(book.priceScale_, PriceBand(book.tickSize_, book.minPrice_, book.maxPrice_), book.matching_ != 0);
+		if (!config.band_.isValid())
+			return false;
+		config.expectedOrders_ = orderCount;
+		if (!addBook(book.productId_, config).loadSnapshot(book, levels, orders))
+			return false;
+	}
+
+	lastSeqNo_ = header.seqNo_;
+	return data == end;
+}
+
+int OrderBookManager::priceScale(int productId) const
+{
+	const OrderBook* book = findBook(productId);
+	return book ? book->getPriceScale() : PRICE::DEFAULT_SCALE;
+}
+
+int OrderBookManager::orderPriceScale(int orderId) const
+{
+	auto it = orderIndex_.find(orderId);
+	return (it != orderIndex_.end()) ? it->second.book_->getPriceScale() : PRICE::DEFAULT_SCALE;
+}
+
+// take actions as per the orderbook for the productId (look up orderbook from orderId if productId not already available)
+Result OrderBookManager::action(const char action, int productId, int orderId, char side, int quantity, Price price, char orderType) noexcept
+{
+	Result result = execute(action, productId, orderId, side, quantity, price, orderType);
+	if (result == Result::OK)
+	{
+		// unsequenced, numbered on acceptance so that a snapshot covers it and a replay past the snapshot skips it
+		++lastSeqNo_;
+		if (journal_)
+			journal_->append(Msg::make(lastSeqNo_, action, productId, orderId, side, quantity, price, orderType));
+	}
+
+	return result;
+}
+
+Result OrderBookManager::execute(const char action, int productId, int orderId, char side, int quantity, Price price, char orderType) noexcept
+{
+	Result result = Result::OK;
+	OB_STATS(uint64_t mark = STATS::now();) // the lookup phase includes the input checks
+
+	switch (action)
+	{
+	case ACTION::NEW:
+	{
+		// sanitize the received inputs
+		result = sanitizeInputs(productId, orderId, side, quantity, price, orderType);
+		if (result != Result::OK)
+			break;
+
+		OrderBook* book = findBook(productId);
+		if (!book)
+		{
+			// no book comes in under concurrent readers
+			if (booksFrozen_)
+			{
+				result = Result::UNKNOWN_PRODUCT;
+				break;
+			}
+
+			// the book checks for duplicates in the shared index, only a new book has to be spared
+			if (orderIndex_.contains(orderId))
+			{
+				result = Result::DUPLICATE_ORDER_ID;
+				break;
+			}
+			book = &addBook(productId, ProductConfig());
+		}
+		OB_STATS(latency_.lap(STATS::Phase::LOOKUP, action, mark);)
+
+		// add new order now
+		result = book->enterOrder(orderId, side, price, quantity, orderType);
+		OB_STATS(latency_.lap(STATS::Phase::UPDATE, action, mark);)
+		break;
+	}
+	case ACTION::MODIFY:
+	case ACTION::REMOVE:
+	{
+		// sanitize the received inputs
+		result = sanitizeInputs(orderId, side, quantity, price);
+		if (result != Result::OK)
+			break;
+
+		// check if orderId already exists. the handle takes the book straight to the order
+		auto op = orderIndex_.find(orderId);
+		if (op == orderIndex_.end())
+		{
+			result = Result::UNKNOWN_ORDER_ID;
+			break;
+		}
+		OB_STATS(latency_.lap(STATS::Phase::LOOKUP, action, mark);)
+
+		OrderBook& ob = *op->second.book_;
+		result = (action == ACTION::MODIFY) ? ob.modifyOrder(op, quantity) : ob.deleteOrder(op);
+		OB_STATS(latency_.lap(STATS::Phase::UPDATE, action, mark);)
+		break;
+	}
+	case ACTION::TRADE:
+	{
+		// sanitize the received inputs
+		result = sanitizeInputs(productId, quantity, price);
+		if (result != Result::OK)
+			break;
+
+		OrderBook* book = findBook(productId);
+		if (!book)
+		{
+			result = Result::UNKNOWN_PRODUCT;
+			break;
+		}
+		OB_STATS(latency_.lap(STATS::Phase::LOOKUP, action, mark);)
+
+		result = book->handleTrade(price, quantity);
+		OB_STATS(latency_.lap(STATS::Phase::TRADE, action, mark);)
+		break;
+	}
+	default:
+		result = Result::INVALID_ACTION;
+		break;
+	}
+
+	if (result != Result::OK)
+		rejects_.record(result, action, productId, orderId);
+
+	return result;
+}
+
+Result OrderBookManager::action(std::string_view msg) noexcept
+{
+	OB_STATS(uint64_t mark = STATS::now();)
+	ParsedMsg parsed;
+	Result result = parseMsg(msg, parsed);
+	if (result != Result::OK)
+	{
+		rejects_.record(result, parsed.action_, 0, 0);
+		return result;
+	}
+
+	// the price can only be decoded once the scale of its product is known
+	const bool byOrderId = (parsed.action_ == ACTION::MODIFY || parsed.action_ == ACTION::REMOVE);
+	const int scale = byOrderId ? orderPriceScale(parsed.orderId_) : priceScale(parsed.productId_);
+
+	Price price;
+	if (!parsePrice(parsed.price_, scale, price))
+	{
+		rejects_.record(Result::INVALID_PRICE, parsed.action_, 0, 0);
+		return Result::INVALID_PRICE;
+	}
+	OB_STATS(latency_.lap(STATS::Phase::PARSE, parsed.action_, mark);)
+
+	return apply(Msg::make(0, parsed.action_, parsed.productId_, parsed.orderId_, parsed.side_, parsed.quantity_, price, parsed.orderType_));
+}
+
+Result OrderBookManager::apply(const Msg& msg) noexcept
+{
+	if (msg.seqNo_)
+	{
+		if (msg.seqNo_ <= lastSeqNo_)
+		{
+			// duplicate or replayed message
+			rejects_.record(Result::STALE_SEQ_NO, msg.action_, msg.productId_, msg.orderId_);
+			return Result::STALE_SEQ_NO;
+		}
+		lastSeqNo_ = msg.seqNo_;
+	}
+
+	Result result = execute(msg.action_, msg.productId_, msg.orderId_, msg.side_, msg.quantity_, msg.price_, msg.orderType_ ? msg.orderType_ : ORDERTYPE::LIMIT);
+	if (result != Result::OK)
+		return result;
+
+	if (!msg.seqNo_)
+	{
+		// numbered on acceptance, see action
+		Msg numbered = msg;
+		numbered.seqNo_ = ++lastSeqNo_;
+		if (journal_)
+			journal_->append(numbered);
+	}
+	else if (journal_)
+		journal_->append(msg);
+
+	return result;
+}
+
+size_t OrderBookManager::applyBatch(std::span<const Msg> msgs) noexcept
+{
+	for (const Msg& msg : msgs)
+		apply(msg);
+
+	return msgs.size();
+}
+
+void OrderBookManager::printOB(const int productId/* = 0*/)
+{
+	int quantity;
+	Price price;
+
+	if (!productId)
+	{
+		// print the orderbook for all the existing orderbooks
+		for (const auto& book : books_)
+		{
+			std::cout << "ProductId [" << book->getProductId() << "]" << std::endl;
+			book->printOrderBook();
+
+			book->getLastTradeDetails(price, quantity);
+			std::cout << "Last Traded Price [" << FormattedPrice(price, book->getPriceScale()) << "] Last Traded Quantity [" << quantity << "]" << std::endl;
+		}
+	}
+	else
+	{
+		std::cout << "ProductId [" << productId << "]" << std::endl;
+		const OrderBook* ob = findBook(productId);
+		if (!ob)
+			throw std::runtime_error("OrderBook doesn't exists for productId");
+		ob->printOrderBook();
+
+		ob->getLastTradeDetails(price, quantity);
+		std::cout << "Last Traded Price [" << FormattedPrice(price, ob->getPriceScale()) << "] Last Traded Quantity [" << quantity << "]" << std::endl;
+	}
+}
+
+void OrderBookManager::printStats(std::ostream& os) const
+{
+#ifndef OB_DISABLE_STATS
+	latency_.print(os);
+
+	uint64_t levelsCreated = 0;
+	uint64_t levelsDestroyed = 0;
+	size_t peakDepth = 0;
+	int peakProductId = 0;
+	for (const auto& book : books_)
+	{
+		const BookCounters& counters = book->getCounters();
+		levelsCreated += counters.levelsCreated_;
+		levelsDestroyed += counters.levelsDestroyed_;
+
+		const size_t depth = std::max(counters.peakBidLevels_, counters.peakOfferLevels_);
+		if (depth > peakDepth)
+		{
+			peakDepth = depth;
+			peakProductId = book->getProductId();
+		}
+	}
+
+	os << "Books [" << books_.size() << "] Orders alive [" << orderIndex_.size() << "]" << std::endl;
+	printMemoryUsage(os);
+	os << "Levels created [" << levelsCreated << "] destroyed [" << levelsDestroyed << "] Peak depth [" << peakDepth << "] levels on ProductId [" << peakProductId << "]" << std::endl;
+#else
+	os << "Books [" << books_.size() << "] Orders alive [" << orderIndex_.size() << "]" << std::endl;
+	printMemoryUsage(os);
+#endif
+	rejects_.printCounters(os);
+}
+
+MemoryUsage OrderBookManager::memoryUsage() const
+{
+	MemoryUsage usage;
+	for (const auto& book : books_)
+		usage += book->memoryUsage();
+
+	usage.indices_ += orderIndex_.memoryUsage() + sparseBooks_.memoryUsage() + denseBooks_.capacity() * sizeof(OrderBook*)
+		+ books_.capacity() * sizeof(std::unique_ptr<OrderBook>);
+	return usage;
+}
+
+void OrderBookManager::printMemoryUsage(std::ostream& os) const
+{
+	const MemoryUsage usage = memoryUsage();
+	os << "Memory bytes orders [" << usage.orders_ << "] levels [" << usage.levels_ << "] indices [" << usage.indices_ << "] books [" << usage.books_ << "] total [" << usage.total() << "]" << std::endl;
+}
+
+void OrderBookManager::printExceptions()
+{
+	rejects_.print(std::cout);
 }
\ No newline at end of file
@@ -1,50 +1,135 @@
-#pragma once
-
-#include "orderbook.h"
-#include <map>
-#include <exception>
-
-namespace ACTION
-{
-    const char NEW = 'N';
-    const char MODIFY = 'M';
-    const char REMOVE = 'R';
-    const char TRADE = 'X';
-}
-
-class OrderBookManager
-{
-public:
-    OrderBookManager() = default;
-
-    // do not copy
-    OrderBookManager(const OrderBookManager&) = delete;
-    OrderBookManager& operator=(const OrderBookManager&) = delete;
-
-    void action(const char action, int productId, int orderId, char side, int quantity, double price);
-    void action(const std::string& msg);
-    void printOB(const int productId = 0);
-    void printExceptions();
-
-private:
-    void sanitizeInputs(int productId, int orderId, char side, int quantity, double price);
-    void sanitizeInputs(int orderId, char side, int quantity, double price);
-    void sanitizeInputs(int productId, int quantity, double price);
-
-    typedef std::map<int, OrderBook> ProductIdToOrderBookMap;
-
-    // not required if all the message types (amend & cancels come with the productId)
-    typedef std::map<int, ProductIdToOrderBookMap::iterator> OrderIdToOrderBookMap;
-
-    ProductIdToOrderBookMap prdIdToOrderBook_;
-    OrderIdToOrderBookMap ordIdToOrderBook_;
-
-    struct Exceptions
-    {
-        std::string msg_;
-        int id_;
-        Exceptions(const std::string& msg, const int id) :msg_(msg), id_(id) {}
-    };
-
-    std::vector<Exceptions> exceptions_;
-};
+#pragma once
+
+#include "orderbook.h"
+#include "journal.h"
+#include "msgparser.h"
+#include "msgprotocol.h"
+#include "rejectlog.h"
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace ACTION
+{
+    const char NEW = 'N';
+    const char MODIFY = 'M';
+    const char REMOVE = 'R';
+    const char TRADE = 'X';
+}
+
+class OrderBookManager
+{
+public:
+    // product ids below denseProductIds are looked up by direct index. expectedOrders pre-sizes the order index
+    explicit OrderBookManager(size_t expectedOrders = 0, int denseProductIds = DEFAULT_DENSE_PRODUCT_IDS);
+
+    static const int DEFAULT_DENSE_PRODUCT_IDS = 65536;
+
+    // do not copy
+    OrderBookManager(const OrderBookManager&) = delete;
+    OrderBookManager& operator=(const OrderBookManager&) = delete;
+
+    // price scale, tick size and price band of an instrument. has to be set before its first order. a band
+    // wider than PriceBand::MAX_LADDER_TICKS bounds the prices without a ladder
+    void configureProduct(int productId, const ProductConfig& config);
+
+    // receives the events of every book, existing and future ones. has to outlive the manager
+    void setEventListener(OrderEventListener* listener);
+
+    // level deltas of every book, existing and future ones, go out on the ring. has to outlive the manager
+    void setDeltaRing(DeltaRing* ring);
+
+    // accepted messages are appended to the journal, rejects are not. has to outlive the manager, nullptr stops journaling
+    void setJournal(Journal* journal) { journal_ = journal; }
+
+    // hot path entry points. expected rejects never throw, they come back as the result and are
+    // recorded in the reject log
+    Result action(const char action, int productId, int orderId, char side, int quantity, Price price, char orderType = ORDERTYPE::LIMIT) noexcept;
+    Result action(std::string_view msg) noexcept;
+
+    // binary messages. messages carrying a sequence number not above the last applied one are rejected as stale.
+    // an accepted unsequenced message, text ones included, takes the number after the last one, so the
+    // snapshot and the journal agree on it. a sequenced feed and unsequenced messages are not to be mixed
+    Result apply(const Msg& msg) noexcept;
+    size_t applyBatch(std::span<const Msg> msgs) noexcept;
+    uint64_t getLastSeqNo() const { return lastSeqNo_; }
+
+    // book of a product, nullptr when unknown. books stay put once created, readers on other threads can
+    // hold on to them for getDepth. safe from any thread once concurrent readers are enabled
+    const OrderBook* getOrderBook(int productId) const { return findBook(productId); }
+
+    // lets threads other than the one applying the messages look books up and read them, see
+    // OrderBook::enableConcurrentReaders. has to be called before the first order and after the books are
+    // created through configureProduct, bulkLoad or loadSnapshot. the book lookups are not safe against
+    // a book being added, so from then on no book is: configureProduct throws, bulkLoad and loadSnapshot
+    // return false and a new order for an unknown product is rejected as UNKNOWN_PRODUCT
+    void enableConcurrentReaders()
+    {
+        orderIndex_.enableSharedReads();
+        booksFrozen_ = true;
+    }
+
+    // warm start. the snapshot holds every book and the last sequence number applied, so a replay of the
+    // message log from the start only applies the tail. loading needs a manager without books and leaves
+    // none behind on failure
+    bool saveSnapshot(const std::string& path) const;
+    bool loadSnapshot(const std::string& path);
+    // start of day load of the resting orders of a product into its empty book, created with the default
+    // config unless configured. the load is a base state like a snapshot, it is not journaled. false when
+    // OrderBook::bulkLoad refuses the orders, no book is added then
+    bool bulkLoad(int productId, std::span<const RestingOrder> orders);
+
+    void printOB(const int productId = 0);
+    void printExceptions();
+    // latency percentiles by action and phase, level counters, live orders, memory and rejects by reason. only
+    // the last three when built with OB_DISABLE_STATS
+    void printStats(std::ostream& os) const;
+    void clearStats() { OB_STATS(latency_.clear();) }
+    // bytes held by every book and by the manager's own lookups, see MemoryUsage
+    MemoryUsage memoryUsage() const;
+    const RejectLog& getRejects() const { return rejects_; }
+    uint64_t getRejectCount() const { return rejects_.total(); }
+
+private:
+    // applies one message to the books and records a reject
+    Result execute(const char action, int productId, int orderId, char side, int quantity, Price price, char orderType) noexcept;
+
+    Result sanitizeInputs(int productId, int orderId, char side, int quantity, Price price, char orderType) noexcept;
+    Result sanitizeInputs(int orderId, char side, int quantity, Price price) noexcept;
+    Result sanitizeInputs(int productId, int quantity, Price price) noexcept;
+
+    // fixed point scale of a product's prices, or of the book holding an order
+    int priceScale(int productId) const;
+    int orderPriceScale(int orderId) const;
+
+    OrderBook* findBook(int productId) const;
+    OrderBook& addBook(int productId, const ProductConfig& config);
+    // takes a book built on orderIndex_
+    OrderBook& addBook(std::unique_ptr<OrderBook> book);
+    bool loadBooks(const char* data, const char* end);
+    void printMemoryUsage(std::ostream& os) const;
+    void clearBooks();
+
+    // one index over the live orders of every book, shared with the books so an order is looked up once
+    // per message. declared ahead of the books, which use it till they go away
+    OrderIndex orderIndex_;
+
+    // books are owned in product id order. dense ids index straight into denseBooks_, the others go through a hash map
+    std::vector<std::unique_ptr<OrderBook>> books_;
+    std::vector<OrderBook*> denseBooks_;
+    FlatHashMap<int, OrderBook*> sparseBooks_;
+    const int denseProductIds_;
+
+    RejectLog rejects_;
+    OB_STATS(LatencyStats latency_;)
+
+    OrderEventListener* listener_ = nullptr;
+    DeltaRing* deltaRing_ = nullptr;
+    Journal* journal_ = nullptr;
+
+    uint64_t lastSeqNo_ = 0;
+
+    // set once concurrent readers look books up
+    bool booksFrozen_ = false;
+};
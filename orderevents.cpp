@@ -0,0 +1,88 @@
+#include "orderevents.h"
+#include <ostream>
+
+OrderEventListener& OrderEventListener::null()
+{
+    static OrderEventListener listener;
+    return listener;
+}
+
+void CollectingEventListener::clear()
+{
+    accepted_.clear();
+    fills_.clear();
+    partialFills_.clear();
+    cancels_.clear();
+    trades_.clear();
+    levelChanges_.clear();
+}
+
+void LoggingEventListener::onFill(const FillEvent& event)
+{
+    os_ << "Order id [" << event.orderId_ << "] totally filled!!" << std::endl;
+}
+
+void LoggingEventListener::onPartialFill(const PartialFillEvent& event)
+{
+    os_ << "Order id [" << event.orderId_ << "] partially filled!! New Qty [" << event.remainingQty_ << "]" << std::endl;
+}
+
+void LoggingEventListener::onTrade(const TradeEvent& event)
+{
+    os_ << "Trade Received for productId [" << event.productId_ << "] Total Traded Quantity [" << event.lastTradedQty_ << "] Traded Price [" << FormattedPrice(event.price_, event.priceScale_) << "]" << std::endl;
+}
+
+AsyncEventListener::AsyncEventListener(OrderEventListener& target, size_t queueSize) :target_(target), queue_(queueSize)
+{
+    worker_ = std::thread([this]() {
+        unsigned idleSpins = 0;
+        while (running_.load(std::memory_order_acquire))
+        {
+            if (!queue_.empty())
+            {
+                drain();
+                idleSpins = 0;
+            }
+            else if (++idleSpins > IDLE_SPINS)
+                std::this_thread::sleep_for(IDLE_SLEEP);
+            else
+                std::this_thread::yield();
+        }
+        drain(); // whatever got queued before the stop request
+    });
+}
+
+AsyncEventListener::~AsyncEventListener()
+{
+    running_.store(false, std::memory_order_release);
+    worker_.join();
+}
+
+void AsyncEventListener::push(const Event& event)
+{
+    while (!queue_.tryPush(event))
+        std::this_thread::yield();
+}
+
+void AsyncEventListener::drain()
+{
+    Event event;
+    while (queue_.tryPop(event))
+    {
+        std::visit([this](const auto& ev) {
+            typedef std::decay_t<decltype(ev)> EventType;
+            if constexpr (std::is_same_v<EventType, OrderAcceptedEvent>)
+                target_.onOrderAccepted(ev);
+            else if constexpr (std::is_same_v<EventType, FillEvent>)
+                target_.onFill(ev);
+            else if constexpr (std::is_same_v<EventType, PartialFillEvent>)
+                target_.onPartialFill(ev);
+            else if constexpr (std::is_same_v<EventType, CancelEvent>)
+                target_.onCancel(ev);
+            else if constexpr (std::is_same_v<EventType, TradeEvent>)
+                target_.onTrade(ev);
+            else
+                target_.onLevelChange(ev);
+        }, event);
+    }
+}
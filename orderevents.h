@@ -0,0 +1,170 @@
+#pragma once
+
+#include "price.h"
+#include "spscqueue.h"
+#include <chrono>
+#include <iosfwd>
+#include <thread>
+#include <variant>
+#include <vector>
+
+// prices of every event are in the fixed point scale priceScale_ of their product
+
+struct OrderAcceptedEvent
+{
+    int productId_;
+    int orderId_;
+    char side_;
+    Price price_;
+    int quantity_;
+    int priceScale_;
+};
+
+struct FillEvent
+{
+    int productId_;
+    int orderId_;
+    char side_;
+    Price price_;
+    int fillQty_;
+    int priceScale_;
+};
+
+struct PartialFillEvent
+{
+    int productId_;
+    int orderId_;
+    char side_;
+    Price price_;
+    int fillQty_;
+    int remainingQty_;
+    int priceScale_;
+};
+
+struct CancelEvent
+{
+    int productId_;
+    int orderId_;
+    char side_;
+    Price price_;
+    int quantity_;
+    int priceScale_;
+};
+
+struct TradeEvent
+{
+    int productId_;
+    Price price_;
+    int quantity_;
+    int lastTradedQty_; // total traded so far at this price
+    int priceScale_;
+};
+
+enum class LevelChange : uint8_t
+{
+    ADD,
+    UPDATE,
+    REMOVE,
+};
+
+struct LevelChangeEvent
+{
+    int productId_;
+    char side_;
+    LevelChange change_;
+    Price price_;
+    int totalQty_; // 0 once removed
+    int orderCount_;
+    int priceScale_;
+};
+
+/*
+ * @brief : sink of everything an OrderBook does. Callbacks run synchronously on
+ * the thread applying the messages, so implementations should return quickly.
+ * Every callback defaults to a no-op, override only what you need.
+ */
+class OrderEventListener
+{
+public:
+    virtual ~OrderEventListener() = default;
+
+    virtual void onOrderAccepted(const OrderAcceptedEvent&) {}
+    virtual void onFill(const FillEvent&) {}
+    virtual void onPartialFill(const PartialFillEvent&) {}
+    virtual void onCancel(const CancelEvent&) {}
+    virtual void onTrade(const TradeEvent&) {}
+    virtual void onLevelChange(const LevelChangeEvent&) {}
+
+    // shared listener used by books nobody listens to
+    static OrderEventListener& null();
+};
+
+// stores every event for later inspection
+class CollectingEventListener : public OrderEventListener
+{
+public:
+    std::vector<OrderAcceptedEvent> accepted_;
+    std::vector<FillEvent> fills_;
+    std::vector<PartialFillEvent> partialFills_;
+    std::vector<CancelEvent> cancels_;
+    std::vector<TradeEvent> trades_;
+    std::vector<LevelChangeEvent> levelChanges_;
+
+    void onOrderAccepted(const OrderAcceptedEvent& event) override { accepted_.push_back(event); }
+    void onFill(const FillEvent& event) override { fills_.push_back(event); }
+    void onPartialFill(const PartialFillEvent& event) override { partialFills_.push_back(event); }
+    void onCancel(const CancelEvent& event) override { cancels_.push_back(event); }
+    void onTrade(const TradeEvent& event) override { trades_.push_back(event); }
+    void onLevelChange(const LevelChangeEvent& event) override { levelChanges_.push_back(event); }
+
+    void clear();
+};
+
+// human readable log of fills and trades
+class LoggingEventListener : public OrderEventListener
+{
+private:
+    std::ostream& os_;
+
+public:
+    explicit LoggingEventListener(std::ostream& os) :os_(os) {}
+
+    void onFill(const FillEvent& event) override;
+    void onPartialFill(const PartialFillEvent& event) override;
+    void onTrade(const TradeEvent& event) override;
+};
+
+/*
+ * @brief : hands the events over to a background thread through a lock free
+ * queue and replays them there on the wrapped listener, which keeps slow sinks
+ * (logging, publishing) off the thread applying the messages.
+ * The producer spins when the queue is full, nothing is dropped.
+ */
+class AsyncEventListener : public OrderEventListener
+{
+private:
+    typedef std::variant<OrderAcceptedEvent, FillEvent, PartialFillEvent, CancelEvent, TradeEvent, LevelChangeEvent> Event;
+
+    // an idle worker yields for that many rounds, then sleeps IDLE_SLEEP between looks at the queue
+    static const unsigned IDLE_SPINS = 1024;
+    static constexpr std::chrono::microseconds IDLE_SLEEP{ 50 };
+
+    OrderEventListener& target_;
+    SpscQueue<Event> queue_;
+    std::atomic<bool> running_{ true };
+    std::thread worker_;
+
+    void push(const Event& event);
+    void drain();
+
+public:
+    AsyncEventListener(OrderEventListener& target, size_t queueSize = 65536);
+    ~AsyncEventListener();
+
+    void onOrderAccepted(const OrderAcceptedEvent& event) override { push(event); }
+    void onFill(const FillEvent& event) override { push(event); }
+    void onPartialFill(const PartialFillEvent& event) override { push(event); }
+    void onCancel(const CancelEvent& event) override { push(event); }
+    void onTrade(const TradeEvent& event) override { push(event); }
+    void onLevelChange(const LevelChangeEvent& event) override { push(event); }
+};
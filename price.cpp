@@ -0,0 +1,120 @@
+#include "price.h"
+#include <cmath>
+#include <limits>
+#include <ostream>
+
+namespace
+{
+    const Price POW10[PRICE::MAX_SCALE + 1] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+}
+
+bool parsePrice(const char* first, const char* last, int scale, Price& price)
+{
+    if (scale < 0 || scale > PRICE::MAX_SCALE)
+        return false;
+
+    bool negative = false;
+    if (first != last && (*first == '-' || *first == '+'))
+    {
+        negative = (*first == '-');
+        ++first;
+    }
+
+    const Price maxValue = std::numeric_limits<Price>::max();
+    Price value = 0;
+    int decimals = 0;
+    bool seenDot = false, seenDigit = false;
+
+    for (; first != last; ++first)
+    {
+        const char c = *first;
+        if (c == '.')
+        {
+            if (seenDot)
+                return false;
+            seenDot = true;
+            continue;
+        }
+
+        if (c < '0' || c > '9')
+            return false;
+
+        seenDigit = true;
+        if (seenDot && decimals == scale)
+        {
+            // only trailing zeros may go past the precision of the instrument
+            if (c != '0')
+                return false;
+            continue;
+        }
+
+        if (value > (maxValue - (c - '0')) / 10)
+            return false;
+
+        value = value * 10 + (c - '0');
+        if (seenDot)
+            ++decimals;
+    }
+
+    if (!seenDigit)
+        return false;
+
+    const Price factor = POW10[scale - decimals];
+    if (value > maxValue / factor)
+        return false;
+
+    value *= factor;
+    price = negative ? -value : value;
+    return true;
+}
+
+bool parsePrice(std::string_view str, int scale, Price& price)
+{
+    return parsePrice(str.data(), str.data() + str.size(), scale, price);
+}
+
+Price toPrice(double value, int scale)
+{
+    return static_cast<Price>(std::llround(value * static_cast<double>(POW10[scale])));
+}
+
+double toDouble(Price price, int scale)
+{
+    return static_cast<double>(price) / static_cast<double>(POW10[scale]);
+}
+
+std::ostream& operator<<(std::ostream& os, const FormattedPrice& formattedPrice)
+{
+    Price value = formattedPrice.price_;
+    if (value < 0)
+    {
+        os << '-';
+        value = -value;
+    }
+
+    const Price factor = POW10[formattedPrice.scale_];
+    os << value / factor;
+
+    Price fraction = value % factor;
+    if (fraction)
+    {
+        // strip the trailing zeros off the fraction
+        int digits = formattedPrice.scale_;
+        while (fraction % 10 == 0)
+        {
+            fraction /= 10;
+            --digits;
+        }
+
+        char buf[PRICE::MAX_SCALE + 1];
+        for (int i = digits - 1; i >= 0; --i)
+        {
+            buf[i] = static_cast<char>('0' + fraction % 10);
+            fraction /= 10;
+        }
+        os << '.';
+        os.write(buf, digits);
+    }
+
+    return os;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <string_view>
+
+// prices are carried as integer multiples of 10^-scale of the instrument (fixed point)
+typedef int64_t Price;
+
+namespace PRICE
+{
+    const int DEFAULT_SCALE = 4;
+    const int MAX_SCALE = 9;
+}
+
+// exact decimal text to fixed point conversion. fails on malformed input, on more
+// significant decimals than the scale carries and on overflow
+bool parsePrice(const char* first, const char* last, int scale, Price& price);
+bool parsePrice(std::string_view str, int scale, Price& price);
+
+// nearest fixed point value of a floating point price
+Price toPrice(double value, int scale);
+double toDouble(Price price, int scale);
+
+// stream a fixed point price as a decimal without trailing zeros. eg : std::cout << FormattedPrice(price, scale)
+struct FormattedPrice
+{
+    Price price_;
+    int scale_;
+
+    FormattedPrice(Price price, int scale) :price_(price), scale_(scale) {}
+};
+
+std::ostream& operator<<(std::ostream& os, const FormattedPrice& formattedPrice);
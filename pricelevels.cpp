@@ -0,0 +1,5 @@
+#include "pricelevels.h"
+
+// the cold members of both sides are instantiated here once, the hot ones are inline in the header
+template class BookSide<SIDE::BUY>;
+template class BookSide<SIDE::SELL>;
@@ -0,0 +1,547 @@
+#pragma once
+
+#include "order.h"
+#include "objectpool.h"
+#include "fenwick.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <set>
+
+/*
+ * @brief : optional price grid of an instrument. When configured the book
+ * keeps its levels in a contiguous ladder indexed by the tick offset from
+ * minPrice_, otherwise it falls back to a sparse sorted set of levels. A band
+ * of more than MAX_LADDER_TICKS ticks still bounds the prices but keeps its
+ * levels sparse, a ladder costs memory for every tick of the band.
+ */
+struct PriceBand
+{
+    // in the fixed point units of the instrument's prices
+    Price tickSize_ = 0;
+    Price minPrice_ = 0;
+    Price maxPrice_ = 0;
+
+    // about 16MB of ladder and depth trees per book at the limit
+    static const size_t MAX_LADDER_TICKS = size_t(1) << 17;
+
+    PriceBand() = default;
+    PriceBand(Price tickSize, Price minPrice, Price maxPrice) :tickSize_(tickSize), minPrice_(minPrice), maxPrice_(maxPrice) {}
+
+    bool isConfigured() const { return tickSize_ > 0 && maxPrice_ >= minPrice_; }
+    // either left out entirely or a positive tick over a non negative range
+    bool isValid() const { return (tickSize_ == 0 && minPrice_ == 0 && maxPrice_ == 0) || (isConfigured() && minPrice_ >= 0); }
+    // configured and narrow enough for a ladder, isValid has to hold
+    bool fitsLadder() const { return isConfigured() && static_cast<uint64_t>(maxPrice_ - minPrice_) / static_cast<uint64_t>(tickSize_) < MAX_LADDER_TICKS; }
+};
+
+/*
+ * @brief : BookSide holds the price levels of one side of an OrderBook, ordered
+ * from the best price to the worst one. The side is a template parameter, so the
+ * ordering, the ladder walk and the crossing test compile down to the one
+ * direction of the side with no branch left on it. The book resolves the char
+ * side of a message once and stays on the typed side from there.
+ */
+template<char Side>
+class BookSide
+{
+    static_assert(Side == SIDE::BUY || Side == SIDE::SELL, "a book side is either bids or offers");
+
+public:
+    // true when lhs is a better price than rhs on this side
+    static bool isBetter(Price lhs, Price rhs) { return (Side == SIDE::BUY) ? lhs > rhs : lhs < rhs; }
+    // true when a level of this side at levelPrice trades with an order or a print at price
+    static bool crosses(Price levelPrice, Price price) { return (Side == SIDE::BUY) ? levelPrice >= price : levelPrice <= price; }
+
+private:
+    const PriceBand band_;
+
+    // ladder mode : one level per tick in the band, laid out contiguously, and the index of the best non empty one
+    std::vector<OrderList> ladder_;
+    int bestIdx_ = -1;
+
+    // ladder mode : one bit per tick set while its level holds orders, and one summary bit per word of those
+    // set while the word has any bit set. the next non empty level is then a couple of word scans away
+    // however many empty ticks lie in between
+    std::vector<uint64_t> occupied_;
+    std::vector<uint64_t> occupiedWords_;
+
+    // ladder mode : quantity and notional (quantity x price) of every tick cumulated from the best end of the
+    // band, for the depth queries. indexedQty_ is the quantity of each tick as last indexed
+    FenwickTree<int64_t> qtyTree_;
+    FenwickTree<int64_t> notionalTree_;
+    std::vector<int> indexedQty_;
+
+    // sparse mode : pooled levels, a sorted set of distinct prices and a price to orderlist hash map for constant time lookup
+    struct LevelCompare
+    {
+        bool operator() (const OrderList* OL1, const OrderList* OL2) const { return isBetter(OL1->price_, OL2->price_); }
+    };
+
+    typedef std::set<OrderList*, LevelCompare, PoolAllocator<OrderList*>> OrderListSet;
+    typedef std::unordered_map<Price, OrderList*, std::hash<Price>, std::equal_to<Price>, PoolAllocator<std::pair<const Price, OrderList*>>> OrderListHashMap;
+
+    ObjectPool<OrderList> levelPool_;
+    OrderListSet levelSet_;
+    OrderListHashMap levelHashMap_;
+
+    size_t levelCount_ = 0;
+
+    // worse prices sit at lower ladder indices for bids and at higher ones for offers
+    static const int WORSE_STEP = (Side == SIDE::BUY) ? -1 : 1;
+
+    // ladder mode only, the ladder is at most MAX_LADDER_TICKS long so the index fits
+    int tickIndex(Price price) const { return static_cast<int>((price - band_.minPrice_) / band_.tickSize_); }
+    static bool isBetterIdx(int lhs, int rhs) { return (Side == SIDE::BUY) ? lhs > rhs : lhs < rhs; }
+    int nextIdx(int idx) const;
+    void markOccupied(int idx);
+    void markEmpty(int idx);
+    // tree position of a ladder index and back, position 0 is the best end of the band
+    size_t position(int idx) const { return (Side == SIDE::BUY) ? ladder_.size() - 1 - static_cast<size_t>(idx) : static_cast<size_t>(idx); }
+    int indexAt(size_t pos) const { return static_cast<int>((Side == SIDE::BUY) ? ladder_.size() - 1 - pos : pos); }
+
+    // do not copy
+    BookSide(const BookSide&) = delete;
+    BookSide& operator=(const BookSide&) = delete;
+
+public:
+    explicit BookSide(const PriceBand& band);
+
+    bool isLadder() const { return !ladder_.empty(); }
+    const PriceBand& band() const { return band_; }
+    bool isValidPrice(Price price) const;
+    bool empty() const { return levelCount_ == 0; }
+    size_t size() const { return levelCount_; }
+
+    // lookups return nullptr when there is no such level
+    OrderList* find(Price price) const;
+    OrderList* best() const;
+    OrderList* next(const OrderList* level) const;
+
+    // queue the order at the back of the level of price, creating the level if required. true for a new level
+    bool add(Order* order, Price price);
+    // bulk build : open an empty level for a price worse than every level held, to be filled through
+    // OrderList::pushBack right away. nullptr when the price is already held
+    OrderList* appendLevel(Price price);
+    // bulk build : room for count more levels, so the sparse pool and hash map do not grow level by level
+    void reserveLevels(size_t count);
+    // unlink the order from its level and drop the level once empty. constant time on a ladder, the next best
+    // level included. true when the level went away
+    bool remove(Order* order);
+
+    // true when the levels at or through price hold quantity. only the levels needed are looked at
+    bool canFill(Price price, int quantity) const;
+
+    // the book reports every new total of a level here so a ladder keeps its cumulative depth, reindex
+    // rebuilds it after a bulk build. both do nothing on sparse levels
+    void indexLevel(Price price, int totalQty);
+    void reindex();
+
+    // bytes held by the price levels, a whole ladder or the pooled sparse levels, and by the lookups over
+    // them : the sparse set and hash map, estimated from their node layout, and the cumulative depth trees
+    size_t levelMemoryUsage() const { return ladder_.capacity() * sizeof(OrderList) + levelPool_.memoryUsage(); }
+    size_t indexMemoryUsage() const;
+
+    // depth queries, log n on a ladder and a walk of the levels involved otherwise
+    // worst price reached sweeping quantity off the side, false when the side holds less
+    bool priceForQuantity(int64_t quantity, Price& price) const;
+    // sum of quantity x price over that sweep
+    bool notionalForQuantity(int64_t quantity, int64_t& notional) const;
+    // quantity resting at limit or better
+    int64_t quantityWithin(Price limit) const;
+};
+
+typedef BookSide<SIDE::BUY> BidSide;
+typedef BookSide<SIDE::SELL> OfferSide;
+
+template<char Side>
+BookSide<Side>::BookSide(const PriceBand& band) :band_(band)
+{
+    if (band_.isValid() && band_.fitsLadder())
+    {
+        const size_t ticks = static_cast<size_t>((band_.maxPrice_ - band_.minPrice_) / band_.tickSize_ + 1);
+        ladder_.reserve(ticks);
+        for (size_t idx = 0; idx < ticks; ++idx)
+            ladder_.emplace_back(band_.minPrice_ + static_cast<Price>(idx) * band_.tickSize_);
+
+        qtyTree_.reset(ticks);
+        notionalTree_.reset(ticks);
+        indexedQty_.assign(ticks, 0);
+
+        occupied_.assign((ticks + 63) / 64, 0);
+        occupiedWords_.assign((occupied_.size() + 63) / 64, 0);
+    }
+}
+
+template<char Side>
+bool BookSide<Side>::isValidPrice(Price price) const
+{
+    if (!band_.isConfigured())
+        return true;
+
+    // price has to fall inside the band and on a tick boundary
+    return price >= band_.minPrice_ && price <= band_.maxPrice_ && (price - band_.minPrice_) % band_.tickSize_ == 0;
+}
+
+// next non empty slot towards the worse prices, found through the occupancy bits. -1 when none left
+template<char Side>
+int BookSide<Side>::nextIdx(int idx) const
+{
+    if constexpr (Side == SIDE::SELL)
+    {
+        // worse is higher, first bit set above idx
+        const size_t pos = static_cast<size_t>(idx) + 1;
+        if (pos >= ladder_.size())
+            return -1;
+
+        size_t word = pos / 64;
+        const uint64_t bits = occupied_[word] & (~uint64_t(0) << (pos % 64));
+        if (bits)
+            return static_cast<int>(word * 64 + std::countr_zero(bits));
+
+        // first occupied word past it
+        if (++word == occupied_.size())
+            return -1;
+        size_t group = word / 64;
+        uint64_t words = occupiedWords_[group] & (~uint64_t(0) << (word % 64));
+        while (!words)
+        {
+            if (++group == occupiedWords_.size())
+                return -1;
+            words = occupiedWords_[group];
+        }
+        word = group * 64 + std::countr_zero(words);
+        return static_cast<int>(word * 64 + std::countr_zero(occupied_[word]));
+    }
+    else
+    {
+        // worse is lower, last bit set below idx
+        if (idx <= 0)
+            return -1;
+        const size_t pos = static_cast<size_t>(idx) - 1;
+
+        size_t word = pos / 64;
+        const uint64_t bits = occupied_[word] & (~uint64_t(0) >> (63 - pos % 64));
+        if (bits)
+            return static_cast<int>(word * 64 + 63 - std::countl_zero(bits));
+
+        // last occupied word before it
+        if (word-- == 0)
+            return -1;
+        size_t group = word / 64;
+        uint64_t words = occupiedWords_[group] & (~uint64_t(0) >> (63 - word % 64));
+        while (!words)
+        {
+            if (group-- == 0)
+                return -1;
+            words = occupiedWords_[group];
+        }
+        word = group * 64 + 63 - std::countl_zero(words);
+        return static_cast<int>(word * 64 + 63 - std::countl_zero(occupied_[word]));
+    }
+}
+
+template<char Side>
+inline void BookSide<Side>::markOccupied(int idx)
+{
+    const size_t word = static_cast<size_t>(idx) / 64;
+    occupied_[word] |= uint64_t(1) << (idx % 64);
+    occupiedWords_[word / 64] |= uint64_t(1) << (word % 64);
+}
+
+template<char Side>
+inline void BookSide<Side>::markEmpty(int idx)
+{
+    const size_t word = static_cast<size_t>(idx) / 64;
+    occupied_[word] &= ~(uint64_t(1) << (idx % 64));
+    if (!occupied_[word])
+        occupiedWords_[word / 64] &= ~(uint64_t(1) << (word % 64));
+}
+
+template<char Side>
+inline OrderList* BookSide<Side>::find(Price price) const
+{
+    if (isLadder())
+    {
+        const OrderList& level = ladder_[tickIndex(price)];
+        return level.empty() ? nullptr : const_cast<OrderList*>(&level);
+    }
+
+    typename OrderListHashMap::const_iterator iter = levelHashMap_.find(price);
+    return (iter != levelHashMap_.end()) ? iter->second : nullptr;
+}
+
+template<char Side>
+inline OrderList* BookSide<Side>::best() const
+{
+    if (isLadder())
+        return (bestIdx_ >= 0) ? const_cast<OrderList*>(&ladder_[bestIdx_]) : nullptr;
+
+    return levelSet_.empty() ? nullptr : *levelSet_.begin();
+}
+
+template<char Side>
+inline OrderList* BookSide<Side>::next(const OrderList* level) const
+{
+    if (isLadder())
+    {
+        const int idx = nextIdx(static_cast<int>(level - ladder_.data()));
+        return (idx >= 0) ? const_cast<OrderList*>(&ladder_[idx]) : nullptr;
+    }
+
+    typename OrderListSet::const_iterator iter = levelSet_.upper_bound(const_cast<OrderList*>(level));
+    return (iter != levelSet_.end()) ? *iter : nullptr;
+}
+
+template<char Side>
+inline bool BookSide<Side>::add(Order* order, Price price)
+{
+    if (isLadder())
+    {
+        const int idx = tickIndex(price);
+        OrderList& level = ladder_[idx];
+        const bool newLevel = level.empty();
+        if (newLevel)
+        {
+            // new price .. constant time, only the cached best index might move
+            if (bestIdx_ < 0 || isBetterIdx(idx, bestIdx_))
+                bestIdx_ = idx;
+            markOccupied(idx);
+            ++levelCount_;
+        }
+        level.pushBack(order, Side);
+        return newLevel;
+    }
+
+    typename OrderListHashMap::iterator iter = levelHashMap_.find(price);
+    if (iter != levelHashMap_.end())
+    {
+        // price already exists
+        iter->second->pushBack(order, Side);
+        return false;
+    }
+    else
+    {
+        // new price .. need to insert into set
+        OrderList* level = levelPool_.create(price);
+        level->pushBack(order, Side);
+        levelHashMap_.emplace(price, level);
+        levelSet_.insert(level); // logn insert cost since bst
+        ++levelCount_;
+        return true;
+    }
+}
+
+template<char Side>
+OrderList* BookSide<Side>::appendLevel(Price price)
+{
+    if (isLadder())
+    {
+        const int idx = tickIndex(price);
+        OrderList& level = ladder_[idx];
+        if (!level.empty())
+            return nullptr;
+
+        if (bestIdx_ < 0 || isBetterIdx(idx, bestIdx_))
+            bestIdx_ = idx;
+        markOccupied(idx);
+        ++levelCount_;
+        return &level;
+    }
+
+    if (levelHashMap_.find(price) != levelHashMap_.end())
+        return nullptr;
+
+    // worst price so far, the set takes it at the end in constant time
+    OrderList* level = levelPool_.create(price);
+    levelHashMap_.emplace(price, level);
+    levelSet_.emplace_hint(levelSet_.end(), level);
+    ++levelCount_;
+    return level;
+}
+
+template<char Side>
+void BookSide<Side>::reserveLevels(size_t count)
+{
+    // a ladder holds every level of its band already
+    if (isLadder())
+        return;
+
+    levelPool_.reserve(count);
+    levelHashMap_.reserve(levelHashMap_.size() + count);
+}
+
+template<char Side>
+inline bool BookSide<Side>::remove(Order* order)
+{
+    OrderList* level = order->level();
+    level->unlink(order);
+
+    if (!level->empty())
+        return false;
+
+    // remove the empty level off the book
+    --levelCount_;
+    if (isLadder())
+    {
+        const int idx = static_cast<int>(level - ladder_.data());
+        markEmpty(idx);
+        if (idx == bestIdx_)
+            bestIdx_ = nextIdx(idx);
+        return true;
+    }
+
+    levelSet_.erase(level);
+    levelHashMap_.erase(level->price_);
+    levelPool_.destroy(level);
+    return true;
+}
+
+template<char Side>
+bool BookSide<Side>::canFill(Price price, int quantity) const
+{
+    for (const OrderList* level = best(); level && crosses(level->price_, price); level = next(level))
+    {
+        quantity -= level->totalQty_;
+        if (quantity <= 0)
+            return true;
+    }
+
+    return false;
+}
+
+template<char Side>
+size_t BookSide<Side>::indexMemoryUsage() const
+{
+    // a red black node carries its color and three links, a hash node its next link
+    const size_t setNode = sizeof(int) + 3 * sizeof(void*) + sizeof(typename OrderListSet::value_type);
+    const size_t hashNode = sizeof(void*) + sizeof(typename OrderListHashMap::value_type);
+
+    return levelSet_.size() * setNode + levelHashMap_.size() * hashNode + levelHashMap_.bucket_count() * sizeof(void*)
+        + qtyTree_.memoryUsage() + notionalTree_.memoryUsage() + indexedQty_.capacity() * sizeof(int)
+        + (occupied_.capacity() + occupiedWords_.capacity()) * sizeof(uint64_t);
+}
+
+template<char Side>
+inline void BookSide<Side>::indexLevel(Price price, int totalQty)
+{
+    if (!isLadder())
+        return;
+
+    const int idx = tickIndex(price);
+    const int delta = totalQty - indexedQty_[idx];
+    if (!delta)
+        return;
+
+    indexedQty_[idx] = totalQty;
+    qtyTree_.add(position(idx), delta);
+    notionalTree_.add(position(idx), static_cast<int64_t>(delta) * price);
+}
+
+template<char Side>
+void BookSide<Side>::reindex()
+{
+    if (!isLadder())
+        return;
+
+    for (size_t idx = 0; idx < ladder_.size(); ++idx)
+        indexedQty_[idx] = ladder_[idx].totalQty_;
+
+    qtyTree_.build(ladder_.size(), [this](size_t pos) { return static_cast<int64_t>(indexedQty_[indexAt(pos)]); });
+    notionalTree_.build(ladder_.size(), [this](size_t pos) { return static_cast<int64_t>(indexedQty_[indexAt(pos)]) * ladder_[indexAt(pos)].price_; });
+}
+
+template<char Side>
+bool BookSide<Side>::priceForQuantity(int64_t quantity, Price& price) const
+{
+    if (quantity <= 0)
+        return false;
+
+    if (isLadder())
+    {
+        const size_t pos = qtyTree_.lowerBound(quantity);
+        if (pos == qtyTree_.size())
+            return false;
+
+        price = ladder_[indexAt(pos)].price_;
+        return true;
+    }
+
+    for (const OrderList* level = best(); level; level = next(level))
+    {
+        quantity -= level->totalQty_;
+        if (quantity <= 0)
+        {
+            price = level->price_;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template<char Side>
+bool BookSide<Side>::notionalForQuantity(int64_t quantity, int64_t& notional) const
+{
+    if (quantity <= 0)
+        return false;
+
+    if (isLadder())
+    {
+        const size_t pos = qtyTree_.lowerBound(quantity);
+        if (pos == qtyTree_.size())
+            return false;
+
+        // every level better than the last one is taken whole, the last one for what is left
+        const int64_t qtyBefore = pos ? qtyTree_.prefix(pos - 1) : 0;
+        notional = (pos ? notionalTree_.prefix(pos - 1) : 0) + (quantity - qtyBefore) * ladder_[indexAt(pos)].price_;
+        return true;
+    }
+
+    notional = 0;
+    for (const OrderList* level = best(); level; level = next(level))
+    {
+        const int64_t taken = std::min<int64_t>(quantity, level->totalQty_);
+        notional += taken * level->price_;
+        quantity -= taken;
+        if (quantity == 0)
+            return true;
+    }
+
+    return false;
+}
+
+template<char Side>
+int64_t BookSide<Side>::quantityWithin(Price limit) const
+{
+    if (isLadder())
+    {
+        // last tick at limit or better counted from the best end of the band
+        if (Side == SIDE::BUY)
+        {
+            if (limit > band_.maxPrice_)
+                return 0;
+            if (limit <= band_.minPrice_)
+                return qtyTree_.total();
+            const int idx = static_cast<int>((limit - band_.minPrice_ + band_.tickSize_ - 1) / band_.tickSize_);
+            return qtyTree_.prefix(position(idx));
+        }
+
+        if (limit < band_.minPrice_)
+            return 0;
+        if (limit >= band_.maxPrice_)
+            return qtyTree_.total();
+        return qtyTree_.prefix(position(tickIndex(limit)));
+    }
+
+    int64_t quantity = 0;
+    for (const OrderList* level = best(); level && crosses(level->price_, limit); level = next(level))
+        quantity += level->totalQty_;
+    return quantity;
+}
+
+// both sides are compiled once, in pricelevels.cpp
+extern template class BookSide<SIDE::BUY>;
+extern template class BookSide<SIDE::SELL>;
@@ -0,0 +1,34 @@
+#include "rejectlog.h"
+#include <ostream>
+
+void RejectLog::clear()
+{
+    total_ = 0;
+    counters_.fill(0);
+}
+
+void RejectLog::print(std::ostream& os) const
+{
+    if (total_ > size())
+        os << "[" << total_ - size() << "] older rejects dropped" << std::endl;
+
+    for (size_t idx = 0; idx < size(); ++idx)
+    {
+        const Entry& elem = at(idx);
+        if (elem.orderId_)
+            os << "OrderId [" << elem.orderId_ << "] msg [" << toString(elem.result_) << "]" << std::endl;
+        else if (elem.productId_ && !isParseError(elem.result_))
+            os << "ProductId [" << elem.productId_ << "] msg [" << toString(elem.result_) << "]" << std::endl;
+        else
+            os << "Msg parsing failed with error [" << toString(elem.result_) << "]" << std::endl;
+    }
+}
+
+void RejectLog::printCounters(std::ostream& os) const
+{
+    for (size_t idx = 1; idx < counters_.size(); ++idx)
+    {
+        if (counters_[idx])
+            os << toString(static_cast<Result>(idx)) << " : " << counters_[idx] << std::endl;
+    }
+}
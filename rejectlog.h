@@ -0,0 +1,50 @@
+#pragma once
+
+#include "result.h"
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+/*
+ * @brief : bounded record of the rejected messages. The most recent capacity
+ * rejects are kept in a ring, older ones are overwritten, while the per result
+ * counters cover the whole session. Recording never allocates.
+ */
+class RejectLog
+{
+public:
+    struct Entry
+    {
+        Result result_;
+        char action_;
+        int productId_;
+        int orderId_;
+    };
+
+private:
+    std::vector<Entry> ring_;
+    uint64_t total_ = 0;
+    std::array<uint64_t, static_cast<size_t>(Result::COUNT)> counters_{};
+
+public:
+    explicit RejectLog(size_t capacity = 1024) :ring_(capacity ? capacity : 1) {}
+
+    void record(Result result, char action, int productId, int orderId) noexcept
+    {
+        ring_[total_ % ring_.size()] = Entry{ result, action, productId, orderId };
+        ++total_;
+        ++counters_[static_cast<size_t>(result)];
+    }
+
+    uint64_t total() const { return total_; }
+    uint64_t count(Result result) const { return counters_[static_cast<size_t>(result)]; }
+
+    // number of rejects still held in the ring and access to them, oldest first
+    size_t size() const { return total_ < ring_.size() ? static_cast<size_t>(total_) : ring_.size(); }
+    const Entry& at(size_t idx) const { return ring_[(total_ - size() + idx) % ring_.size()]; }
+
+    void clear();
+    void print(std::ostream& os) const;
+    void printCounters(std::ostream& os) const;
+};
@@ -0,0 +1,31 @@
+#include "result.h"
+
+const char* toString(Result result)
+{
+    switch (result)
+    {
+    case Result::OK: return "Ok";
+    case Result::EMPTY_MESSAGE: return "Empty message received";
+    case Result::INVALID_FIELD_COUNT: return "Invalid number of arguments for the action";
+    case Result::INVALID_NUMBER: return "Invalid numeric field received";
+    case Result::INVALID_PRICE: return "Invalid price received";
+    case Result::INVALID_ACTION: return "Invalid Action provided!!";
+    case Result::INVALID_PRODUCT_ID: return "Received invalid productId";
+    case Result::INVALID_ORDER_ID: return "Received invalid orderId";
+    case Result::INVALID_SIDE: return "Invalid Side received";
+    case Result::INVALID_PRICE_QTY: return "Invalid price/quantity received";
+    case Result::INVALID_ORDER_TYPE: return "Order type not supported by the book";
+    case Result::STALE_SEQ_NO: return "Stale sequence number received";
+    case Result::DUPLICATE_ORDER_ID: return "OrderId already exists!!!";
+    case Result::UNKNOWN_ORDER_ID: return "OrderId not available!!!";
+    case Result::UNKNOWN_PRODUCT: return "OrderBook doesn't exists for productId";
+    case Result::PRICE_OUT_OF_BAND: return "Price outside the configured band/tick size";
+    case Result::TRADE_ON_EMPTY_BOOK: return "Trade received on empty order books!!";
+    case Result::TRADE_PRICE_OUT_OF_BOOK: return "Out of order Trade price received!!";
+    case Result::INSUFFICIENT_BUY_QTY: return "Insufficient quantity to fill from Buy side OrderBook!!";
+    case Result::INSUFFICIENT_SELL_QTY: return "Insufficient quantity to fill from Sell side OrderBook!!";
+    case Result::COUNT: break;
+    }
+
+    return "Unknown result";
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+// outcome of every message applied to the books. anything but OK is an expected reject
+enum class Result : uint8_t
+{
+    OK,
+
+    // text parsing
+    EMPTY_MESSAGE,
+    INVALID_FIELD_COUNT,
+    INVALID_NUMBER,
+    INVALID_PRICE,
+
+    // message validation
+    INVALID_ACTION,
+    INVALID_PRODUCT_ID,
+    INVALID_ORDER_ID,
+    INVALID_SIDE,
+    INVALID_PRICE_QTY,
+    INVALID_ORDER_TYPE,
+    STALE_SEQ_NO,
+
+    // book state
+    DUPLICATE_ORDER_ID,
+    UNKNOWN_ORDER_ID,
+    UNKNOWN_PRODUCT,
+    PRICE_OUT_OF_BAND,
+    TRADE_ON_EMPTY_BOOK,
+    TRADE_PRICE_OUT_OF_BOOK,
+    INSUFFICIENT_BUY_QTY,
+    INSUFFICIENT_SELL_QTY,
+
+    COUNT
+};
+
+const char* toString(Result result);
+
+inline bool isParseError(Result result)
+{
+    return result >= Result::EMPTY_MESSAGE && result <= Result::INVALID_PRICE;
+}
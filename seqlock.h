@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/*
+ * @brief : single writer, many readers publication of a small trivially copyable
+ * value. The writer never waits. A reader copies the value out and retries when
+ * the sequence moved underneath it, so a read costs a copy while nothing is
+ * being published. The value is held as relaxed atomic words so the racing
+ * copies stay well defined.
+ */
+template<class T>
+class SeqLock
+{
+private:
+    static_assert(std::is_trivially_copyable<T>::value, "values are copied word by word");
+
+    static const size_t CACHE_LINE = 64;
+    static const size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    alignas(CACHE_LINE) std::atomic<uint64_t> seq_{ 0 }; // odd while a store is in progress
+    std::atomic<uint64_t> words_[WORDS];
+
+    // do not copy
+    SeqLock(const SeqLock&) = delete;
+    SeqLock& operator=(const SeqLock&) = delete;
+
+public:
+    SeqLock()
+    {
+        for (auto& word : words_)
+            word.store(0, std::memory_order_relaxed);
+    }
+
+    // writer side, one thread only
+    void store(const T& value)
+    {
+        uint64_t buffer[WORDS] = {};
+        std::memcpy(buffer, &value, sizeof(T));
+
+        const uint64_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t idx = 0; idx < WORDS; ++idx)
+            words_[idx].store(buffer[idx], std::memory_order_relaxed);
+
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    // any thread
+    T load() const
+    {
+        uint64_t buffer[WORDS];
+        uint64_t before, after;
+        do
+        {
+            before = seq_.load(std::memory_order_acquire);
+            for (size_t idx = 0; idx < WORDS; ++idx)
+                buffer[idx] = words_[idx].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = seq_.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        T value;
+        std::memcpy(&value, buffer, sizeof(T));
+        return value;
+    }
+
+    // number of stores so far
+    uint64_t version() const { return seq_.load(std::memory_order_acquire) >> 1; }
+};
+
+// word sized fields read under a SeqCount while the writer updates them. relaxed atomics through
+// std::atomic_ref on both sides, plain moves on the usual targets
+template<class T>
+inline T relaxedLoad(const T& field) { return std::atomic_ref<T>(const_cast<T&>(field)).load(std::memory_order_relaxed); }
+
+template<class T>
+inline void relaxedStore(T& field, std::type_identity_t<T> value) { std::atomic_ref<T>(field).store(value, std::memory_order_relaxed); }
+
+/*
+ * @brief : the sequence of a SeqLock on its own, for data updated in place
+ * rather than copied out whole, such as a hash index and the records it points
+ * to. The writer brackets each update with beginWrite/endWrite. A reader takes
+ * readBegin, reads, and keeps what it read only when readValidate holds. The
+ * data read has to stay allocated throughout, a reader may see any state of it.
+ * Every field a reader reads is loaded with relaxedLoad and written with
+ * relaxedStore, construction included, so the racing accesses stay well defined.
+ * The scopes should only span the stores, readers spin while one is open.
+ */
+class SeqCount
+{
+private:
+    alignas(64) std::atomic<uint64_t> seq_{ 0 }; // odd while an update is in progress
+
+public:
+    // writer side, one thread only
+    void beginWrite()
+    {
+        seq_.store(seq_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void endWrite() { seq_.store(seq_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // any thread. waits out an update in progress
+    uint64_t readBegin() const
+    {
+        uint64_t seq;
+        while ((seq = seq_.load(std::memory_order_acquire)) & 1)
+            ;
+        return seq;
+    }
+
+    bool readValidate(uint64_t seq) const
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return seq_.load(std::memory_order_relaxed) == seq;
+    }
+
+    // brackets the updates of a scope
+    class WriteScope
+    {
+    private:
+        SeqCount& count_;
+
+        // do not copy
+        WriteScope(const WriteScope&) = delete;
+        WriteScope& operator=(const WriteScope&) = delete;
+
+    public:
+        explicit WriteScope(SeqCount& count) :count_(count) { count_.beginWrite(); }
+        ~WriteScope() { count_.endWrite(); }
+    };
+};
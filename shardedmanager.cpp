@@ -0,0 +1,288 @@
+#include "shardedmanager.h"
+#include <stdexcept>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+ShardedOrderBookManager::ShardedOrderBookManager(size_t shardCount, size_t queueSize, bool pinThreads) :pinThreads_(pinThreads)
+{
+	if (shardCount == 0)
+		throw std::runtime_error("At least one shard is required");
+
+	shards_.reserve(shardCount);
+	for (size_t idx = 0; idx < shardCount; ++idx)
+		shards_.emplace_back(new Shard(queueSize));
+}
+
+ShardedOrderBookManager::~ShardedOrderBookManager()
+{
+	stop();
+}
+
+void ShardedOrderBookManager::configureProduct(int productId, const ProductConfig& config)
+{
+	if (running_.load())
+		throw std::runtime_error("Products have to be configured before the shards start");
+
+	shards_[shardOf(productId)]->manager_.configureProduct(productId, config);
+	productScale_[productId] = config.priceScale_;
+}
+
+void ShardedOrderBookManager::setEventListener(OrderEventListener* listener)
+{
+	if (running_.load())
+		throw std::runtime_error("Listeners have to be set before the shards start");
+
+	for (auto& shard : shards_)
+		shard->listener_ = listener ? listener : &OrderEventListener::null();
+}
+
+void ShardedOrderBookManager::start()
+{
+	if (running_.exchange(true))
+		return;
+
+#ifdef __linux__
+	// the workers go round the cores the process may run on, starting after the core of the calling thread
+	// and leaving it to the dispatcher. it only shares a core when there is no other
+	workerCores_.clear();
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if (pinThreads_ && sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+	{
+		const int dispatcherCore = sched_getcpu();
+		for (int step = 1; step <= CPU_SETSIZE; ++step)
+		{
+			const int core = (dispatcherCore + step) % CPU_SETSIZE;
+			if (core != dispatcherCore && CPU_ISSET(core, &allowed))
+				workerCores_.push_back(core);
+		}
+		if (workerCores_.empty() && dispatcherCore >= 0)
+			workerCores_.push_back(dispatcherCore);
+	}
+#endif
+
+	for (size_t idx = 0; idx < shards_.size(); ++idx)
+		shards_[idx]->worker_ = std::thread(&ShardedOrderBookManager::run, this, idx);
+}
+
+void ShardedOrderBookManager::stop()
+{
+	if (!running_.exchange(false))
+		return;
+
+	for (auto& shard : shards_)
+		shard->worker_.join();
+
+	// the workers are gone, whatever they could not hand over is safe to read
+	collectRetired();
+	for (auto& shard : shards_)
+	{
+		for (int orderId : shard->doneBacklog_)
+			orderProduct_.erase(orderId);
+		shard->doneBacklog_.clear();
+	}
+}
+
+void ShardedOrderBookManager::waitIdle() const
+{
+	for (const auto& shard : shards_)
+	{
+		while (shard->processed_.load(std::memory_order_acquire) != shard->submitted_)
+			std::this_thread::yield();
+	}
+}
+
+void ShardedOrderBookManager::run(size_t shardIdx)
+{
+	Shard& shard = *shards_[shardIdx];
+
+#ifdef __linux__
+	if (!workerCores_.empty())
+	{
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+		CPU_SET(workerCores_[shardIdx % workerCores_.size()], &cpuset);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+	}
+#endif
+
+	Msg msg;
+	unsigned idleSpins = 0;
+	for (;;)
+	{
+		if (!shard.doneBacklog_.empty())
+			shard.flushRetired();
+
+		if (shard.queue_.tryPop(msg))
+		{
+			// the books report the orders they let go, a rejected new order never reaches them
+			if (shard.manager_.apply(msg) != Result::OK && msg.action_ == ACTION::NEW)
+				shard.retire(msg.orderId_);
+			shard.processed_.fetch_add(1, std::memory_order_release);
+			idleSpins = 0;
+			continue;
+		}
+
+		// the queue is empty. stop only once nothing can be left behind
+		if (!running_.load(std::memory_order_acquire))
+		{
+			if (shard.queue_.empty())
+				break;
+			continue;
+		}
+
+		if (++idleSpins > 1024)
+			std::this_thread::yield();
+	}
+}
+
+void ShardedOrderBookManager::Shard::flushRetired()
+{
+	size_t pushed = 0;
+	while (pushed < doneBacklog_.size() && done_.tryPush(doneBacklog_[pushed]))
+		++pushed;
+	doneBacklog_.erase(doneBacklog_.begin(), doneBacklog_.begin() + static_cast<std::ptrdiff_t>(pushed));
+}
+
+void ShardedOrderBookManager::enqueue(size_t shardIdx, const Msg& msg)
+{
+	Shard& shard = *shards_[shardIdx];
+	while (!shard.queue_.tryPush(msg))
+	{
+		// back pressure from a busy shard
+		collectRetired();
+		std::this_thread::yield();
+	}
+	++shard.submitted_;
+}
+
+void ShardedOrderBookManager::collectRetired()
+{
+	int orderId;
+	for (auto& shard : shards_)
+	{
+		while (shard->done_.tryPop(orderId))
+			orderProduct_.erase(orderId);
+	}
+}
+
+Result ShardedOrderBookManager::submit(const Msg& msg)
+{
+	switch (msg.action_)
+	{
+	case ACTION::NEW:
+		if (msg.productId_ <= 0)
+			break;
+		if (msg.orderId_ <= 0)
+		{
+			rejects_.record(Result::INVALID_ORDER_ID, msg.action_, msg.productId_, msg.orderId_);
+			return Result::INVALID_ORDER_ID;
+		}
+
+		// the routes of the orders gone since the last new order go first, so their ids can be taken again
+		collectRetired();
+		if (!orderProduct_.emplace(msg.orderId_, msg.productId_).second)
+		{
+			rejects_.record(Result::DUPLICATE_ORDER_ID, msg.action_, msg.productId_, msg.orderId_);
+			return Result::DUPLICATE_ORDER_ID;
+		}
+		enqueue(shardOf(msg.productId_), msg);
+		return Result::OK;
+	case ACTION::TRADE:
+		if (msg.productId_ <= 0)
+			break;
+		enqueue(shardOf(msg.productId_), msg);
+		return Result::OK;
+	case ACTION::MODIFY:
+	case ACTION::REMOVE:
+	{
+		if (msg.orderId_ <= 0)
+		{
+			rejects_.record(Result::INVALID_ORDER_ID, msg.action_, msg.productId_, msg.orderId_);
+			return Result::INVALID_ORDER_ID;
+		}
+
+		// the route of a cancelled order goes once its shard reports the cancel, like that of a filled one
+		int productId = msg.productId_;
+		if (!productId)
+		{
+			auto it = orderProduct_.find(msg.orderId_);
+			if (it == orderProduct_.end())
+			{
+				rejects_.record(Result::UNKNOWN_ORDER_ID, msg.action_, 0, msg.orderId_);
+				return Result::UNKNOWN_ORDER_ID;
+			}
+			productId = it->second;
+		}
+		enqueue(shardOf(productId), msg);
+		return Result::OK;
+	}
+	default:
+		rejects_.record(Result::INVALID_ACTION, msg.action_, msg.productId_, msg.orderId_);
+		return Result::INVALID_ACTION;
+	}
+
+	rejects_.record(Result::INVALID_PRODUCT_ID, msg.action_, msg.productId_, msg.orderId_);
+	return Result::INVALID_PRODUCT_ID;
+}
+
+size_t ShardedOrderBookManager::submitBatch(std::span<const Msg> msgs)
+{
+	for (const Msg& msg : msgs)
+		submit(msg);
+
+	return msgs.size();
+}
+
+Result ShardedOrderBookManager::action(std::string_view msg)
+{
+	ParsedMsg parsed;
+	Result result = parseMsg(msg, parsed);
+	if (result != Result::OK)
+	{
+		rejects_.record(result, parsed.action_, 0, 0);
+		return result;
+	}
+
+	// resolve the product up front so the shard does not need a lookup and the price its scale
+	int productId = parsed.productId_;
+	if ((parsed.action_ == ACTION::MODIFY || parsed.action_ == ACTION::REMOVE) && parsed.orderId_ > 0)
+	{
+		auto it = orderProduct_.find(parsed.orderId_);
+		productId = (it != orderProduct_.end()) ? it->second : 0;
+	}
+
+	auto scale = productScale_.find(productId);
+	Price price;
+	if (!parsePrice(parsed.price_, (scale != productScale_.end()) ? scale->second : PRICE::DEFAULT_SCALE, price))
+	{
+		rejects_.record(Result::INVALID_PRICE, parsed.action_, 0, 0);
+		return Result::INVALID_PRICE;
+	}
+
+	return submit(Msg::make(0, parsed.action_, parsed.action_ == ACTION::NEW || parsed.action_ == ACTION::TRADE ? productId : 0, parsed.orderId_, parsed.side_, parsed.quantity_, price, parsed.orderType_));
+}
+
+uint64_t ShardedOrderBookManager::getRejectCount() const
+{
+	uint64_t total = rejects_.total();
+	for (const auto& shard : shards_)
+		total += shard->manager_.getRejectCount();
+	return total;
+}
+
+void ShardedOrderBookManager::printOB()
+{
+	for (auto& shard : shards_)
+		shard->manager_.printOB();
+}
+
+void ShardedOrderBookManager::printExceptions()
+{
+	rejects_.print(std::cout);
+	for (auto& shard : shards_)
+		shard->manager_.printExceptions();
+}
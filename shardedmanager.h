@@ -0,0 +1,112 @@
+#pragma once
+
+#include "orderbookmanager.h"
+#include "spscqueue.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/*
+ * @brief : ShardedOrderBookManager partitions the products over N worker threads.
+ * Every shard owns a plain OrderBookManager holding the books of its products and
+ * is fed through its own lock free SPSC queue. The calling thread acts as the
+ * single dispatcher: new orders and trades are routed on the product id, modify
+ * and cancel messages through an order id to product lookup. A product always
+ * lands on the same shard and queues are FIFO, so per product ordering is kept.
+ * An order id is routed from its new order till its shard reports it filled,
+ * cancelled or rejected. A new order reusing an id still routed is rejected,
+ * even when the order it names is already on its way out.
+ *
+ * With pinning on, start() pins the workers to the cores after the one it is
+ * called from, which is left to the dispatcher thread (pin the dispatcher there
+ * to keep it alone on its core).
+ *
+ * Products have to be configured before start(). Listeners are called from the
+ * worker threads and have to be thread safe when shared by several shards.
+ * Shard state can only be inspected once the shards are stopped.
+ */
+class ShardedOrderBookManager
+{
+private:
+    // the shard listens to its own books so it can tell the dispatcher which orders are gone, and passes
+    // every event on to the listener set
+    struct Shard : public OrderEventListener
+    {
+        OrderBookManager manager_;
+        SpscQueue<Msg> queue_;
+        std::thread worker_;
+        std::atomic<uint64_t> processed_{ 0 };
+        uint64_t submitted_ = 0; // dispatcher side only
+
+        // ids of the orders filled, cancelled or rejected, back to the dispatcher so it stops routing them.
+        // the worker never waits on the dispatcher, what the queue has no room for waits in the backlog
+        SpscQueue<int> done_;
+        std::vector<int> doneBacklog_; // worker side only
+        OrderEventListener* listener_ = &OrderEventListener::null();
+
+        explicit Shard(size_t queueSize) :queue_(queueSize), done_(queueSize) { manager_.setEventListener(this); }
+
+        void retire(int orderId) { if (!doneBacklog_.empty() || !done_.tryPush(orderId)) doneBacklog_.push_back(orderId); }
+        void flushRetired();
+
+        void onOrderAccepted(const OrderAcceptedEvent& event) override { listener_->onOrderAccepted(event); }
+        void onFill(const FillEvent& event) override { listener_->onFill(event); retire(event.orderId_); }
+        void onPartialFill(const PartialFillEvent& event) override { listener_->onPartialFill(event); }
+        void onCancel(const CancelEvent& event) override { listener_->onCancel(event); retire(event.orderId_); }
+        void onTrade(const TradeEvent& event) override { listener_->onTrade(event); }
+        void onLevelChange(const LevelChangeEvent& event) override { listener_->onLevelChange(event); }
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::atomic<bool> running_{ false };
+    const bool pinThreads_;
+    std::vector<int> workerCores_; // cores the workers are pinned to in turn, set by start()
+
+    // dispatcher side routing state
+    FlatHashMap<int, int> productScale_;
+    FlatHashMap<int, int> orderProduct_;
+    RejectLog rejects_;
+
+    size_t shardOf(int productId) const { return static_cast<size_t>(static_cast<unsigned>(productId)) % shards_.size(); }
+    void run(size_t shardIdx);
+    void enqueue(size_t shardIdx, const Msg& msg);
+    // drop the routes of the orders the shards are done with
+    void collectRetired();
+
+    // do not copy
+    ShardedOrderBookManager(const ShardedOrderBookManager&) = delete;
+    ShardedOrderBookManager& operator=(const ShardedOrderBookManager&) = delete;
+
+public:
+    explicit ShardedOrderBookManager(size_t shardCount, size_t queueSize = 65536, bool pinThreads = true);
+    ~ShardedOrderBookManager();
+
+    void configureProduct(int productId, const ProductConfig& config);
+    void setEventListener(OrderEventListener* listener);
+
+    void start();
+    // drain every queue and join the workers
+    void stop();
+    // block till every message submitted so far has been applied
+    void waitIdle() const;
+
+    // dispatcher entry points. only routing failures, duplicate order ids included, are reported here. book
+    // rejects land in the shards
+    Result action(std::string_view msg);
+    Result submit(const Msg& msg);
+    size_t submitBatch(std::span<const Msg> msgs);
+
+    size_t getShardCount() const { return shards_.size(); }
+    // events of a shard's books go through setEventListener, not the shard's own manager
+    OrderBookManager& getShard(size_t shardIdx) { return shards_[shardIdx]->manager_; }
+    const OrderBookManager& getShard(size_t shardIdx) const { return shards_[shardIdx]->manager_; }
+    // order ids the dispatcher still routes, live orders and those not yet reported gone
+    size_t getRoutedOrderCount() const { return orderProduct_.size(); }
+    // routing and parse rejects of the dispatcher
+    const RejectLog& getRejects() const { return rejects_; }
+    uint64_t getRejectCount() const;
+
+    void printOB();
+    void printExceptions();
+};
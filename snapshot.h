@@ -0,0 +1,69 @@
+#pragma once
+
+#include "price.h"
+#include <cstdint>
+#include <cstring>
+
+/*
+ * @brief : binary snapshot of every book of a manager, used for warm starts.
+ * The layout is fixed size records in host byte order, 8 byte aligned so the
+ * file can be read straight out of a mapping:
+ *    SnapshotHeader
+ *    per book : SnapshotBook, its bid levels then its offer levels (best first),
+ *               then the orders of those levels in the same order, each level's in time priority
+ */
+struct SnapshotHeader
+{
+    char magic_[8];
+    uint32_t version_;
+    uint32_t bookCount_;
+    uint64_t seqNo_;    // last sequence number applied, replay resumes after it
+    uint64_t reserved_;
+
+    static const uint32_t VERSION = 1;
+
+    static SnapshotHeader make(uint32_t bookCount, uint64_t seqNo)
+    {
+        SnapshotHeader header;
+        std::memcpy(header.magic_, "OBSNAP\0\0", sizeof(header.magic_));
+        header.version_ = VERSION;
+        header.bookCount_ = bookCount;
+        header.seqNo_ = seqNo;
+        header.reserved_ = 0;
+        return header;
+    }
+
+    bool isValid() const { return std::memcmp(magic_, "OBSNAP\0\0", sizeof(magic_)) == 0 && version_ == VERSION; }
+};
+
+struct SnapshotBook
+{
+    int32_t productId_;
+    int32_t priceScale_;
+    Price tickSize_;        // price band, all 0 when not configured
+    Price minPrice_;
+    Price maxPrice_;
+    Price lastTradedPrice_;
+    int32_t lastTradedQty_;
+    uint8_t matching_;
+    uint8_t reserved_[3];
+    uint64_t deltaSeqNo_;
+    uint32_t bidLevels_;
+    uint32_t offerLevels_;
+    uint64_t orderCount_;
+};
+
+struct SnapshotLevel
+{
+    Price price_;
+    int32_t totalQty_;
+    int32_t orderCount_;
+};
+
+struct SnapshotOrder
+{
+    int32_t id_;
+    int32_t quantity_;
+};
+
+static_assert(sizeof(SnapshotHeader) == 32 && sizeof(SnapshotBook) == 72 && sizeof(SnapshotLevel) == 16 && sizeof(SnapshotOrder) == 8, "snapshot records are a file format");
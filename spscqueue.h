@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+/*
+ * @brief : bounded lock free queue for exactly one producer thread and one
+ * consumer thread. Capacity is rounded up to a power of two. Both indices live
+ * on their own cache line and each side caches the other's index so that a
+ * push or pop only touches shared state when the cached view runs out.
+ */
+template<class T>
+class SpscQueue
+{
+private:
+    static_assert(std::is_trivially_copyable<T>::value, "elements are copied in and out of the ring");
+
+    static const size_t CACHE_LINE = 64;
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<T[]> ring_;
+
+    alignas(CACHE_LINE) std::atomic<size_t> head_{ 0 }; // next slot to pop, written by the consumer
+    size_t cachedTail_ = 0;
+
+    alignas(CACHE_LINE) std::atomic<size_t> tail_{ 0 }; // next slot to push, written by the producer
+    size_t cachedHead_ = 0;
+
+    static size_t roundUp(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        return size;
+    }
+
+    // do not copy
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+public:
+    explicit SpscQueue(size_t capacity) :capacity_(roundUp(capacity)), mask_(capacity_ - 1), ring_(new T[capacity_]) {}
+
+    // producer side. false when the queue is full
+    bool tryPush(const T& value)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ == capacity_)
+        {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail - cachedHead_ == capacity_)
+                return false;
+        }
+
+        ring_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side. false when the queue is empty
+    bool tryPop(T& value)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cachedTail_)
+        {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head == cachedTail_)
+                return false;
+        }
+
+        value = ring_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const { return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire); }
+    size_t capacity() const { return capacity_; }
+};
@@ -0,0 +1,128 @@
+#include "stats.h"
+#include "orderbookmanager.h"
+#include <iomanip>
+#include <ostream>
+
+const char* STATS::toString(Phase phase)
+{
+    switch (phase)
+    {
+    case Phase::PARSE: return "parse";
+    case Phase::LOOKUP: return "lookup";
+    case Phase::UPDATE: return "update";
+    case Phase::TRADE: return "trade";
+    default: return "unknown";
+    }
+}
+
+uint64_t LatencyHistogram::bucketHigh(size_t bucket)
+{
+    if (bucket < static_cast<size_t>(SUB_BUCKETS))
+        return bucket;
+
+    const int shift = static_cast<int>(bucket / SUB_BUCKETS) - 1;
+    const uint64_t top = bucket % SUB_BUCKETS + SUB_BUCKETS;
+    return ((top + 1) << shift) - 1;
+}
+
+uint64_t LatencyHistogram::percentile(double pct) const
+{
+    if (!count_)
+        return 0;
+
+    uint64_t rank = static_cast<uint64_t>(pct / 100.0 * static_cast<double>(count_) + 0.5);
+    if (rank < 1)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKETS; ++bucket)
+    {
+        seen += buckets_[bucket];
+        if (seen >= rank)
+            return std::min(bucketHigh(bucket), max_);
+    }
+    return max_;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+    for (size_t bucket = 0; bucket < BUCKETS; ++bucket)
+        buckets_[bucket] += other.buckets_[bucket];
+    count_ += other.count_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+}
+
+void LatencyHistogram::clear()
+{
+    buckets_.fill(0);
+    count_ = 0;
+    sum_ = 0;
+    min_ = UINT64_MAX;
+    max_ = 0;
+}
+
+int LatencyStats::actionIdx(char action)
+{
+    switch (action)
+    {
+    case ACTION::NEW: return 0;
+    case ACTION::MODIFY: return 1;
+    case ACTION::REMOVE: return 2;
+    case ACTION::TRADE: return 3;
+    default: return -1;
+    }
+}
+
+const LatencyHistogram& LatencyStats::get(STATS::Phase phase, char action) const
+{
+    static const LatencyHistogram empty;
+    const int idx = actionIdx(action);
+    return (idx >= 0) ? histograms_[static_cast<size_t>(phase)][idx] : empty;
+}
+
+double LatencyStats::ticksPerNs() const
+{
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime_).count();
+    const uint64_t ticks = STATS::now() - startTicks_;
+
+    // too short a span to calibrate the TSC against, or ticks are ns already
+    if (elapsed < 1000000 || ticks == static_cast<uint64_t>(elapsed))
+        return 1.0;
+    return static_cast<double>(ticks) / static_cast<double>(elapsed);
+}
+
+void LatencyStats::clear()
+{
+    for (auto& phase : histograms_)
+    {
+        for (auto& histogram : phase)
+            histogram.clear();
+    }
+    startTicks_ = STATS::now();
+    startTime_ = std::chrono::steady_clock::now();
+}
+
+void LatencyStats::print(std::ostream& os) const
+{
+    static const char ACTION_CODES[ACTIONS] = { ACTION::NEW, ACTION::MODIFY, ACTION::REMOVE, ACTION::TRADE };
+    const double scale = 1.0 / ticksPerNs();
+    const auto ns = [scale](double ticks) { return static_cast<uint64_t>(ticks * scale + 0.5); };
+
+    os << "Latency (ns)   count     mean      p50      p99    p99.9      max" << std::endl;
+    for (size_t phase = 0; phase < static_cast<size_t>(STATS::Phase::COUNT); ++phase)
+    {
+        for (size_t idx = 0; idx < ACTIONS; ++idx)
+        {
+            const LatencyHistogram& histogram = histograms_[phase][idx];
+            if (!histogram.count())
+                continue;
+
+            os << ACTION_CODES[idx] << ' ' << std::left << std::setw(8) << STATS::toString(static_cast<STATS::Phase>(phase)) << std::right
+                << std::setw(10) << histogram.count() << std::setw(9) << ns(histogram.mean())
+                << std::setw(9) << ns(static_cast<double>(histogram.percentile(50))) << std::setw(9) << ns(static_cast<double>(histogram.percentile(99)))
+                << std::setw(9) << ns(static_cast<double>(histogram.percentile(99.9))) << std::setw(9) << ns(static_cast<double>(histogram.max())) << std::endl;
+        }
+    }
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#elif defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+// instrumentation stays on unless built with -DOB_DISABLE_STATS, which removes the recording code and the counters it feeds
+#ifndef OB_DISABLE_STATS
+#define OB_STATS(...) __VA_ARGS__
+#else
+#define OB_STATS(...)
+#endif
+
+namespace STATS
+{
+    // raw timestamp in ticks, the TSC where there is one (a few ns to read) and steady clock ns elsewhere
+    inline uint64_t now() noexcept
+    {
+#if (defined(_MSC_VER) && defined(_M_X64)) || defined(__x86_64__)
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    enum class Phase : uint8_t
+    {
+        PARSE,   // text to message, price included
+        LOOKUP,  // book or order id lookup
+        UPDATE,  // new, modify or cancel applied to the book
+        TRADE,   // X applied to the book
+        COUNT,
+    };
+
+    const char* toString(Phase phase);
+}
+
+/*
+ * @brief : latency histogram with HDR style log linear buckets. Values below
+ * SUB_BUCKETS are exact, above that every power of two is split in SUB_BUCKETS
+ * so any value is kept within 1/SUB_BUCKETS (~6%). Recording is a couple of
+ * instructions and never allocates.
+ */
+class LatencyHistogram
+{
+public:
+    static const int SUB_BUCKET_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int MAGNITUDES = 40; // up to 2^44 ticks, larger values land in the last bucket
+    static const size_t BUCKETS = static_cast<size_t>(MAGNITUDES + 1) * SUB_BUCKETS;
+
+private:
+    std::array<uint64_t, BUCKETS> buckets_{};
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t min_ = UINT64_MAX;
+    uint64_t max_ = 0;
+
+    static size_t bucketOf(uint64_t value)
+    {
+        if (value < static_cast<uint64_t>(SUB_BUCKETS))
+            return static_cast<size_t>(value);
+
+        const int shift = static_cast<int>(std::bit_width(value)) - 1 - SUB_BUCKET_BITS;
+        if (shift >= MAGNITUDES)
+            return BUCKETS - 1;
+        return static_cast<size_t>(shift + 1) * SUB_BUCKETS + static_cast<size_t>((value >> shift) - SUB_BUCKETS);
+    }
+
+    // highest value held by a bucket
+    static uint64_t bucketHigh(size_t bucket);
+
+public:
+    void record(uint64_t value) noexcept
+    {
+        ++buckets_[bucketOf(value)];
+        ++count_;
+        sum_ += value;
+        if (value < min_)
+            min_ = value;
+        if (value > max_)
+            max_ = value;
+    }
+
+    uint64_t count() const { return count_; }
+    uint64_t min() const { return count_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return count_ ? static_cast<double>(sum_) / static_cast<double>(count_) : 0.0; }
+    // smallest value at or above pct percent of the recorded ones, within the bucket precision
+    uint64_t percentile(double pct) const;
+
+    void merge(const LatencyHistogram& other);
+    void clear();
+};
+
+/*
+ * @brief : latency of each phase of a message, broken down by action. Ticks are
+ * converted to ns when printed, against the steady clock time elapsed since
+ * the stats were created or cleared.
+ */
+class LatencyStats
+{
+private:
+    static const size_t ACTIONS = 4; // N, M, R and X
+
+    LatencyHistogram histograms_[static_cast<size_t>(STATS::Phase::COUNT)][ACTIONS];
+    uint64_t startTicks_;
+    std::chrono::steady_clock::time_point startTime_;
+
+    static int actionIdx(char action);
+
+public:
+    LatencyStats() { clear(); }
+
+    void record(STATS::Phase phase, char action, uint64_t ticks) noexcept
+    {
+        const int idx = actionIdx(action);
+        if (idx >= 0)
+            histograms_[static_cast<size_t>(phase)][idx].record(ticks);
+    }
+
+    // records the ticks since mark and moves the mark on, for back to back phases
+    void lap(STATS::Phase phase, char action, uint64_t& mark) noexcept
+    {
+        const uint64_t now = STATS::now();
+        record(phase, action, now - mark);
+        mark = now;
+    }
+
+    const LatencyHistogram& get(STATS::Phase phase, char action) const;
+    double ticksPerNs() const;
+
+    void clear();
+    void print(std::ostream& os) const;
+};
+
+// level activity of a book
+struct BookCounters
+{
+    uint64_t levelsCreated_ = 0;
+    uint64_t levelsDestroyed_ = 0;
+    size_t peakBidLevels_ = 0;
+    size_t peakOfferLevels_ = 0;
+};
@@ -0,0 +1,800 @@
+// regression checks of the guarantees the manager makes across components. exits non zero on a failure
+#include "orderbookmanager.h"
+#include "shardedmanager.h"
+#include "mappedfile.h"
+#include "deltafeed.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const char* what)
+    {
+        if (!condition)
+        {
+            std::cerr << "FAILED " << what << std::endl;
+            ++failures;
+        }
+    }
+
+    const std::string SCRATCH = "tests.scratch";
+
+    // small deterministic generator so that every run replays the same flow
+    struct Lcg
+    {
+        uint64_t state_;
+        explicit Lcg(uint64_t seed) :state_(seed) {}
+        uint32_t next() { state_ = state_ * 6364136223846793005ULL + 1442695040888963407ULL; return static_cast<uint32_t>(state_ >> 33); }
+        int range(int lo, int hi) { return lo + static_cast<int>(next() % static_cast<uint32_t>(hi - lo + 1)); }
+    };
+
+    bool sameDepth(const DepthSnapshot& a, const DepthSnapshot& b)
+    {
+        if (a.bidCount_ != b.bidCount_ || a.offerCount_ != b.offerCount_ || a.lastTradedPrice_ != b.lastTradedPrice_ || a.lastTradedQty_ != b.lastTradedQty_)
+            return false;
+
+        for (int level = 0; level < a.bidCount_; ++level)
+        {
+            if (a.bids_[level].price_ != b.bids_[level].price_ || a.bids_[level].quantity_ != b.bids_[level].quantity_ || a.bids_[level].orderCount_ != b.bids_[level].orderCount_)
+                return false;
+        }
+        for (int level = 0; level < a.offerCount_; ++level)
+        {
+            if (a.offers_[level].price_ != b.offers_[level].price_ || a.offers_[level].quantity_ != b.offers_[level].quantity_ || a.offers_[level].orderCount_ != b.offers_[level].orderCount_)
+                return false;
+        }
+        return true;
+    }
+
+    bool sameBook(const OrderBookManager& lhs, const OrderBookManager& rhs, int productId)
+    {
+        const OrderBook* left = lhs.getOrderBook(productId);
+        const OrderBook* right = rhs.getOrderBook(productId);
+        return left && right && sameDepth(left->getDepth(), right->getDepth());
+    }
+
+    // a warm start from a snapshot plus the whole journal has to land on the books the journaling manager holds,
+    // messages the snapshot covers applying once only
+    void snapshotJournalRoundTrip()
+    {
+        const std::string journalPath = SCRATCH + ".jnl";
+        const std::string snapshotPath = SCRATCH + ".snap";
+        std::remove(journalPath.c_str());
+
+        OrderBookManager live;
+        Journal journal;
+        check(journal.open(journalPath), "journal opens");
+        live.setJournal(&journal);
+
+        // text messages are unsequenced, partial trade and modify ahead of the snapshot
+        live.action("N,1,1,B,10,100");
+        live.action("N,1,2,S,10,100");
+        live.action("N,1,3,B,5,99");
+        live.action("X,1,3,100"); // would trade again when replayed, the book holds enough
+        live.action("M,3,B,7,99");
+        live.action("R,42,B,1,99"); // rejected, neither applied nor journaled
+        check(live.saveSnapshot(snapshotPath), "snapshot saves");
+
+        // and the same kinds past it, binary unsequenced ones included
+        live.action("X,1,2,100");
+        live.action("R,3,B,7,99");
+        live.apply(Msg::make(0, ACTION::NEW, 2, 10, SIDE::BUY, 3, 1000000));
+        live.apply(Msg::make(0, ACTION::NEW, 2, 11, SIDE::SELL, 4, 1010000));
+        live.action("M,10,B,8,100");
+        check(journal.flush(), "journal syncs");
+        live.setJournal(nullptr);
+        journal.close();
+
+        OrderBookManager restored;
+        check(restored.loadSnapshot(snapshotPath), "snapshot loads");
+
+        MappedFile file;
+        check(file.open(journalPath) && MsgFileHeader::matches(file.data(), file.size()), "journal maps");
+        size_t tornBytes;
+        restored.applyBatch(MsgFileHeader::records(file.data(), file.size(), tornBytes));
+        check(tornBytes == 0, "journal holds whole records");
+
+        check(restored.getLastSeqNo() == live.getLastSeqNo(), "replay ends on the last sequence number");
+        check(sameBook(live, restored, 1), "product 1 restored");
+        check(sameBook(live, restored, 2), "product 2 restored");
+
+        Price price;
+        int quantity;
+        restored.getOrderBook(1)->getLastTradeDetails(price, quantity);
+        check(quantity == 5, "trades ahead of the snapshot apply once");
+
+        std::remove(journalPath.c_str());
+        std::remove(snapshotPath.c_str());
+    }
+
+    // the queue position is read from whichever end of the queue is nearer, both ends have to agree
+    void queuePosition()
+    {
+        OrderBook book(1);
+        for (int id = 1; id <= 7; ++id)
+            book.enterOrder(id, SIDE::BUY, 1000000, id * 10);
+        book.deleteOrder(3);
+        book.modifyOrder(5, 1);
+
+        const int quantities[] = { 0, 10, 20, 0, 40, 1, 60, 70 };
+        int expectedOrders = 0;
+        int expectedQuantity = 0;
+        for (int id = 1; id <= 7; ++id)
+        {
+            if (id == 3)
+                continue;
+
+            int orders = -1;
+            int quantity = -1;
+            check(book.getQueuePosition(id, orders, quantity) && orders == expectedOrders && quantity == expectedQuantity, "queue position");
+            ++expectedOrders;
+            expectedQuantity += quantities[id];
+        }
+
+        int orders;
+        int quantity;
+        check(!book.getQueuePosition(3, orders, quantity), "no queue position once cancelled");
+    }
+
+    // a rebuilder fed from before a bulk load follows it, a refused load leaves no book behind
+    void bulkLoadDeltas()
+    {
+        OrderBookManager manager;
+        DeltaRing ring(1024);
+        manager.setDeltaRing(&ring);
+
+        const RestingOrder refused[] = { { 1, SIDE::BUY, 1000000, 10 }, { 2, SIDE::SELL, 1010000, 0 } };
+        check(!manager.bulkLoad(1, refused), "invalid load refused");
+        check(manager.getOrderBook(1) == nullptr, "refused load adds no book");
+
+        const RestingOrder orders[] = { { 1, SIDE::BUY, 990000, 10 }, { 2, SIDE::SELL, 1010000, 5 }, { 3, SIDE::BUY, 1000000, 7 }, { 4, SIDE::BUY, 990000, 3 } };
+        check(manager.bulkLoad(1, orders), "load accepted");
+        manager.action(ACTION::NEW, 1, 5, SIDE::SELL, 4, 1020000);
+
+        DepthRebuilder rebuilder;
+        uint64_t cursor = 0;
+        rebuilder.poll(ring, cursor);
+
+        const DepthSnapshot book = manager.getOrderBook(1)->getDepth();
+        const DepthSnapshot rebuilt = rebuilder.getDepth(1);
+        check(!rebuilder.isStale(1) && rebuilt.bidCount_ == 2 && rebuilt.offerCount_ == 2, "rebuilder follows the load");
+        check(rebuilt.bids_[1].price_ == book.bids_[1].price_ && rebuilt.bids_[1].quantity_ == 13 && rebuilt.bids_[1].orderCount_ == 2, "loaded level rebuilt");
+    }
+
+    // a book used directly, without the checks of a manager in front of it, refuses orders and trades without quantity
+    void quantityChecks()
+    {
+        OrderBook book(1);
+        check(book.enterOrder(1, SIDE::BUY, 1000000, 0) == Result::INVALID_PRICE_QTY, "zero quantity refused");
+        check(book.enterOrder(2, SIDE::BUY, 1000000, -5) == Result::INVALID_PRICE_QTY, "negative quantity refused");
+        check(book.getDepth().bidCount_ == 0, "nothing rests");
+
+        check(book.enterOrder(3, SIDE::BUY, 1000000, 10) == Result::OK && book.enterOrder(4, SIDE::SELL, 1000000, 10) == Result::OK, "orders accepted");
+        check(book.handleTrade(1000000, 0) == Result::INVALID_PRICE_QTY, "trade without quantity refused");
+        check(book.modifyOrder(3, 0) == Result::INVALID_PRICE_QTY, "modify to zero refused");
+        const DepthSnapshot depth = book.getDepth();
+        check(depth.bidCount_ == 1 && depth.bids_[0].quantity_ == 10 && depth.lastTradedQty_ == 0, "book untouched");
+    }
+
+    // incoming orders on a matching book, one case per order type
+    void matching()
+    {
+        const ProductConfig config(PRICE::DEFAULT_SCALE, PriceBand(), true);
+        Price price;
+        int quantity;
+
+        {
+            // a crossing limit takes what crosses and rests the remainder at its own price
+            OrderBook book(1, config);
+            book.enterOrder(1, SIDE::SELL, 1000000, 5);
+            book.enterOrder(2, SIDE::SELL, 1010000, 5);
+            check(book.enterOrder(3, SIDE::BUY, 1000000, 8) == Result::OK, "crossing limit accepted");
+            const DepthSnapshot depth = book.getDepth();
+            check(depth.bidCount_ == 1 && depth.bids_[0].price_ == 1000000 && depth.bids_[0].quantity_ == 3, "limit remainder rests");
+            check(depth.offerCount_ == 1 && depth.offers_[0].price_ == 1010000, "crossed level consumed");
+            book.getLastTradeDetails(price, quantity);
+            check(price == 1000000 && quantity == 5, "limit traded at the resting price");
+        }
+        {
+            // immediate or cancel trades what it can and drops the rest
+            OrderBook book(1, config);
+            book.enterOrder(1, SIDE::SELL, 1000000, 5);
+            check(book.enterOrder(2, SIDE::BUY, 1000000, 8, ORDERTYPE::IOC) == Result::OK, "ioc accepted");
+            RestingOrder record;
+            check(!book.getOrderFromId(2, record), "ioc remainder cancelled");
+            const DepthSnapshot depth = book.getDepth();
+            check(depth.bidCount_ == 0 && depth.offerCount_ == 0, "ioc leaves nothing");
+        }
+        {
+            // fill or kill short of liquidity trades nothing, then one that the crossing levels cover sweeps them
+            OrderBook book(1, config);
+            book.enterOrder(1, SIDE::SELL, 1000000, 5);
+            book.enterOrder(2, SIDE::SELL, 1010000, 5);
+            book.enterOrder(3, SIDE::SELL, 1020000, 5);
+            check(book.enterOrder(4, SIDE::BUY, 1010000, 11, ORDERTYPE::FOK) == Result::OK, "short fok accepted");
+            DepthSnapshot depth = book.getDepth();
+            check(depth.offerCount_ == 3 && depth.offers_[0].quantity_ == 5 && depth.offers_[1].quantity_ == 5 && depth.bidCount_ == 0, "short fok leaves the book untouched");
+            book.getLastTradeDetails(price, quantity);
+            check(quantity == 0, "short fok does not trade");
+
+            check(book.enterOrder(5, SIDE::BUY, 1020000, 12, ORDERTYPE::FOK) == Result::OK, "fok accepted");
+            depth = book.getDepth();
+            check(depth.offerCount_ == 1 && depth.offers_[0].price_ == 1020000 && depth.offers_[0].quantity_ == 3 && depth.bidCount_ == 0, "fok filled across levels");
+            book.getLastTradeDetails(price, quantity);
+            check(price == 1020000 && quantity == 2, "fok last fill at the worst level");
+        }
+        {
+            // a market order against an empty side trades nothing and never rests
+            OrderBook book(1, config);
+            book.enterOrder(1, SIDE::BUY, 990000, 5);
+            check(book.enterOrder(2, SIDE::BUY, 0, 5, ORDERTYPE::MARKET) == Result::OK, "market accepted");
+            const DepthSnapshot depth = book.getDepth();
+            check(depth.bidCount_ == 1 && depth.bids_[0].quantity_ == 5 && depth.offerCount_ == 0, "market on an empty side rests nothing");
+        }
+        {
+            // a replica book only takes limit orders
+            OrderBook book(1);
+            book.enterOrder(1, SIDE::SELL, 1000000, 5);
+            for (char type : { ORDERTYPE::MARKET, ORDERTYPE::IOC, ORDERTYPE::FOK })
+                check(book.enterOrder(2, SIDE::BUY, 1000000, 5, type) == Result::INVALID_ORDER_TYPE, "order type needs a matching book");
+            check(book.getDepth().offerCount_ == 1 && book.getDepth().offers_[0].quantity_ == 5, "refused types leave the book untouched");
+        }
+    }
+
+    // the flat map against std::unordered_map : a cluster wrapping past the end of the table erased from the
+    // middle, growth under load, erased keys coming back, and a random mix of the three
+    void flatHashMap()
+    {
+        typedef FlatHashMap<int, int> Map;
+
+        // two keys homed on each of the slots 14, 15 and 0 of the 16 slot table (same hash as the map), so the
+        // cluster runs from slot 14 over the end of the table into slot 3
+        auto homeOf = [](int key) { return static_cast<size_t>((static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ULL) >> 60); };
+        std::vector<int> wrapping;
+        for (size_t home : { size_t(14), size_t(15), size_t(0) })
+        {
+            for (int key = 1, count = 0; count < 2; ++key)
+            {
+                if (homeOf(key) == home)
+                {
+                    wrapping.push_back(key);
+                    ++count;
+                }
+            }
+        }
+        for (size_t first = 0; first < wrapping.size(); ++first)
+        {
+            Map map;
+            for (int key : wrapping)
+                map.emplace(key, key * 10);
+            check(map.capacity() == 16, "cluster stays in the first table");
+            map.enableSharedReads();
+
+            check(map.erase(wrapping[first]), "wrapped entry erased");
+            for (size_t idx = 0; idx < wrapping.size(); ++idx)
+            {
+                int value = 0;
+                const bool expected = idx != first;
+                check(map.contains(wrapping[idx]) == expected && map.findShared(wrapping[idx], value) == expected && (!expected || value == wrapping[idx] * 10), "wrapped cluster shifted back");
+            }
+            check(map.emplace(wrapping[first], 1).second && map.find(wrapping[first])->second == 1, "erased key reinserted");
+            check(map.size() == wrapping.size(), "cluster size");
+        }
+
+        // growth from the smallest table while holding every key, then half of them erased and put back
+        Map map;
+        const int KEYS = 100000;
+        for (int key = 1; key <= KEYS; ++key)
+            map.emplace(key * 7, key);
+        bool found = map.size() == static_cast<size_t>(KEYS);
+        for (int key = 1; found && key <= KEYS; ++key)
+            found = map.contains(key * 7) && map.find(key * 7)->second == key && !map.contains(key * 7 + 1);
+        check(found, "every key kept through the rehashes");
+        for (int key = 1; key <= KEYS; key += 2)
+            map.erase(key * 7);
+        for (int key = 1; key <= KEYS; key += 2)
+            map.emplace(key * 7, -key);
+        found = map.size() == static_cast<size_t>(KEYS);
+        for (int key = 1; found && key <= KEYS; ++key)
+            found = map.find(key * 7)->second == ((key & 1) ? -key : key);
+        check(found, "erased keys come back with their new values");
+
+        // random inserts and erases over a small key range keep clusters long
+        Map flat;
+        std::unordered_map<int, int> reference;
+        Lcg rng(7);
+        bool same = true;
+        for (int step = 0; same && step < 200000; ++step)
+        {
+            const int key = rng.range(-500, 500);
+            if (rng.range(0, 2))
+                same = flat.emplace(key, step).second == reference.emplace(key, step).second;
+            else
+                same = flat.erase(key) == (reference.erase(key) == 1);
+        }
+        same = same && flat.size() == reference.size();
+        for (const auto& elem : reference)
+            same = same && flat.contains(elem.first) && flat.find(elem.first)->second == elem.second;
+        size_t visited = 0;
+        for (auto iter = flat.begin(); iter != flat.end(); ++iter, ++visited)
+            same = same && reference.count(iter->first) && reference[iter->first] == iter->second;
+        check(same && visited == reference.size(), "flat map matches std::unordered_map");
+    }
+
+    // the cached top levels against the levels of the resting orders, on a ladder and a sparse book fed alike.
+    // the books hold up to three times the cached depth, so emptied cached levels are refilled from deeper ones
+    void depthCache()
+    {
+        const int IDS = 400;
+        const Price MID = 1000000;
+        const Price TICK = 100;
+        const int TICKS = 3 * DepthSnapshot::LEVELS;
+
+        OrderBook ladder(1, ProductConfig(PRICE::DEFAULT_SCALE, PriceBand(TICK, MID - TICKS * TICK, MID + TICKS * TICK)));
+        OrderBook sparse(2);
+        std::vector<RestingOrder> live(IDS + 1, RestingOrder{ 0, 0, 0, 0 });
+
+        auto expected = [&]()
+        {
+            std::map<Price, DepthLevel, std::greater<Price>> bids;
+            std::map<Price, DepthLevel> offers;
+            for (const RestingOrder& order : live)
+            {
+                if (!order.id_)
+                    continue;
+                DepthLevel& level = (order.side_ == SIDE::BUY) ? bids[order.price_] : offers[order.price_];
+                level.price_ = order.price_;
+                level.quantity_ += order.quantity_;
+                ++level.orderCount_;
+            }
+
+            DepthSnapshot depth;
+            for (auto iter = bids.begin(); iter != bids.end() && depth.bidCount_ < DepthSnapshot::LEVELS; ++iter)
+                depth.bids_[depth.bidCount_++] = iter->second;
+            for (auto iter = offers.begin(); iter != offers.end() && depth.offerCount_ < DepthSnapshot::LEVELS; ++iter)
+                depth.offers_[depth.offerCount_++] = iter->second;
+            return depth;
+        };
+
+        // every level filled, then the best ones emptied one at a time
+        int id = 0;
+        for (int tick = 1; tick <= TICKS; ++tick)
+        {
+            for (OrderBook* book : { &ladder, &sparse })
+            {
+                book->enterOrder(id + 1, SIDE::BUY, MID - tick * TICK, tick);
+                book->enterOrder(id + 2, SIDE::SELL, MID + tick * TICK, tick);
+            }
+            live[id + 1] = RestingOrder{ id + 1, SIDE::BUY, MID - tick * TICK, tick };
+            live[id + 2] = RestingOrder{ id + 2, SIDE::SELL, MID + tick * TICK, tick };
+            id += 2;
+        }
+        bool same = sameDepth(ladder.getDepth(), expected()) && sameDepth(sparse.getDepth(), expected());
+        for (int order = 1; same && order <= 2 * DepthSnapshot::LEVELS; ++order)
+        {
+            ladder.deleteOrder(order);
+            sparse.deleteOrder(order);
+            live[order] = RestingOrder{ 0, 0, 0, 0 };
+            same = sameDepth(ladder.getDepth(), expected()) && sameDepth(sparse.getDepth(), expected());
+        }
+        check(same && ladder.getDepth().bidCount_ == DepthSnapshot::LEVELS, "emptied best levels refilled from deeper ones");
+
+        // then a random flow over the same ticks
+        Lcg rng(11);
+        for (int step = 0; same && step < 5000; ++step)
+        {
+            const int order = rng.range(1, IDS);
+            const int dice = rng.range(0, 9);
+            if (live[order].id_ && dice < 4)
+            {
+                ladder.deleteOrder(order);
+                sparse.deleteOrder(order);
+                live[order] = RestingOrder{ 0, 0, 0, 0 };
+            }
+            else if (live[order].id_)
+            {
+                const int quantity = rng.range(1, 100);
+                ladder.modifyOrder(order, quantity);
+                sparse.modifyOrder(order, quantity);
+                live[order].quantity_ = quantity;
+            }
+            else
+            {
+                const bool buy = (rng.next() & 1) != 0;
+                const Price price = buy ? MID - rng.range(1, TICKS) * TICK : MID + rng.range(1, TICKS) * TICK;
+                const int quantity = rng.range(1, 100);
+                ladder.enterOrder(order, buy ? SIDE::BUY : SIDE::SELL, price, quantity);
+                sparse.enterOrder(order, buy ? SIDE::BUY : SIDE::SELL, price, quantity);
+                live[order] = RestingOrder{ order, buy ? SIDE::BUY : SIDE::SELL, price, quantity };
+            }
+            same = sameDepth(ladder.getDepth(), expected()) && sameDepth(sparse.getDepth(), expected());
+        }
+        check(same, "ladder and sparse depth match the resting orders");
+    }
+
+    // a reader that falls more than the ring behind notices it was lapped, and once reset from the books it
+    // follows the deltas again from the same cursor
+    void deltaOverrun()
+    {
+        OrderBookManager manager;
+        DeltaRing ring(8);
+        manager.setDeltaRing(&ring);
+
+        DepthRebuilder rebuilder;
+        uint64_t cursor = 0;
+        manager.action(ACTION::NEW, 1, 1, SIDE::BUY, 10, 990000);
+        manager.action(ACTION::NEW, 2, 2, SIDE::SELL, 10, 1010000);
+        check(rebuilder.poll(ring, cursor) == 2 && !rebuilder.isStale(1) && !rebuilder.isStale(2), "reader keeps up");
+
+        // more level changes than the ring holds while the reader is away
+        for (int id = 3; id <= 30; ++id)
+            manager.action(ACTION::NEW, 1 + id % 2, id, (id % 4 < 2) ? SIDE::BUY : SIDE::SELL, id, (id % 4 < 2) ? 990000 - id * 100 : 1010000 + id * 100);
+        rebuilder.poll(ring, cursor);
+        check(rebuilder.isStale(1) && rebuilder.isStale(2), "lapped reader notices the overrun");
+        check(cursor == ring.published(), "lapped reader catches up with the ring");
+
+        // the books move on before the reader resyncs from them, so the ring holds deltas the resync reflects
+        manager.action(ACTION::REMOVE, 0, 3, SIDE::SELL, 3, 1010300);
+        manager.action(ACTION::MODIFY, 0, 4, SIDE::BUY, 9, 989600);
+        manager.action(ACTION::NEW, 1, 32, SIDE::SELL, 5, 1020000);
+        for (int productId = 1; productId <= 2; ++productId)
+        {
+            const OrderBook* book = manager.getOrderBook(productId);
+            const DepthSnapshot depth = book->getDepth();
+            rebuilder.reset(productId, book->getDeltaSeqNo());
+            for (int level = 0; level < depth.bidCount_; ++level)
+                rebuilder.setLevel(productId, SIDE::BUY, depth.bids_[level]);
+            for (int level = 0; level < depth.offerCount_; ++level)
+                rebuilder.setLevel(productId, SIDE::SELL, depth.offers_[level]);
+        }
+        manager.action(ACTION::REMOVE, 0, 1, SIDE::BUY, 10, 990000);
+        manager.action(ACTION::MODIFY, 0, 2, SIDE::SELL, 7, 1010000);
+        manager.action(ACTION::NEW, 2, 31, SIDE::BUY, 5, 980000);
+        rebuilder.poll(ring, cursor);
+
+        for (int productId = 1; productId <= 2; ++productId)
+            check(!rebuilder.isStale(productId) && sameDepth(rebuilder.getDepth(productId), manager.getOrderBook(productId)->getDepth()), "resynced reader follows the books");
+    }
+
+    // exact decimal to fixed point, anything the scale can not carry exactly or the type can not hold is refused
+    void priceParsing()
+    {
+        auto parses = [](const char* text, int scale, Price expected)
+        {
+            Price price = 0;
+            return parsePrice(text, scale, price) && price == expected;
+        };
+        auto refused = [](const char* text, int scale)
+        {
+            Price price = 42;
+            return !parsePrice(text, scale, price) && price == 42;
+        };
+
+        check(parses("101.25", 4, 1012500) && parses("7", 4, 70000) && parses(".5", 4, 5000) && parses("3.", 4, 30000), "plain prices");
+        check(parses("1.2345", 4, 12345) && parses("1.234500", 4, 12345) && refused("1.23451", 4) && refused("1.5", 0), "decimals past the scale");
+        check(parses("-1.5", 4, -15000) && parses("+2", 4, 20000) && refused("-", 4) && refused("+-1", 4) && refused("--1", 4) && refused("1-", 4), "signs");
+        check(refused("", 4) && refused(".", 4) && refused("-.", 4) && refused("1..2", 4) && refused("1.2.3", 4) && refused(" 1", 4) && refused("1a", 4), "malformed");
+        check(parses("922337203685477.5807", 4, std::numeric_limits<Price>::max()) && refused("922337203685477.5808", 4), "largest price");
+        check(refused("99999999999999999999", 0) && refused("922337203685478", 4) && refused("-922337203685478", 4), "overflow");
+        check(refused("1", -1) && refused("1", PRICE::MAX_SCALE + 1) && parses("0.000000001", PRICE::MAX_SCALE, 1), "scale range");
+    }
+
+    // text messages field by field and binary captures record by record
+    void msgParsing()
+    {
+        ParsedMsg parsed;
+        check(parseMsg("N,1,2,B,10,101.5", parsed) == Result::OK && parsed.action_ == ACTION::NEW && parsed.productId_ == 1 && parsed.orderId_ == 2
+            && parsed.side_ == SIDE::BUY && parsed.quantity_ == 10 && parsed.price_ == "101.5" && parsed.orderType_ == ORDERTYPE::LIMIT, "new order");
+        check(parseMsg("N;1;2;S;10;101.5;I", parsed) == Result::OK && parsed.side_ == SIDE::SELL && parsed.orderType_ == ORDERTYPE::IOC, "new order with a type");
+        check(parseMsg("M,2,B,5,101.5", parsed) == Result::OK && parsed.orderId_ == 2 && parsed.quantity_ == 5, "modify");
+        check(parseMsg("X,1,10,101.5", parsed) == Result::OK && parsed.productId_ == 1 && parsed.quantity_ == 10, "trade");
+
+        // a single character field has to be exactly one character
+        check(parseMsg("N,1,2,Buy,10,101.5", parsed) == Result::INVALID_SIDE, "multi character side");
+        check(parseMsg("R,2,Sell,5,101.5", parsed) == Result::INVALID_SIDE, "multi character side on a cancel");
+        check(parseMsg("New,1,2,B,10,101.5", parsed) == Result::INVALID_ACTION, "multi character action");
+        check(parseMsg("N,1,2,B,10,101.5,IOC", parsed) == Result::INVALID_ORDER_TYPE, "multi character order type");
+
+        // separators run together, so an empty field shortens the message
+        check(parseMsg("", parsed) == Result::EMPTY_MESSAGE && parseMsg(" ,, ", parsed) == Result::EMPTY_MESSAGE, "empty message");
+        check(parseMsg("N,1,,B,10,101.5", parsed) == Result::INVALID_FIELD_COUNT && parseMsg("X,1,10", parsed) == Result::INVALID_FIELD_COUNT, "missing field");
+        check(parseMsg("N,1,2,B,10,101.5,L,9", parsed) == Result::INVALID_FIELD_COUNT, "extra field");
+        check(parseMsg("N,1,x,B,10,101.5", parsed) == Result::INVALID_NUMBER && parseMsg("N,1,2,B,99999999999,101.5", parsed) == Result::INVALID_NUMBER, "bad number");
+        check(parseMsg("Q,1,2,B,10,101.5", parsed) == Result::INVALID_ACTION, "unknown action");
+
+        // the manager takes the price parse on from there
+        OrderBookManager manager;
+        check(manager.action("N,1,2,B,10,101.12345") == Result::INVALID_PRICE && manager.action("N,1,2,B,10,-101") == Result::INVALID_PRICE_QTY, "text price refused");
+
+        // a capture cut short in the middle of its last record
+        std::vector<char> capture(sizeof(MsgFileHeader) + 3 * sizeof(Msg));
+        const MsgFileHeader header = MsgFileHeader::make();
+        std::memcpy(capture.data(), &header, sizeof(header));
+        for (int idx = 0; idx < 3; ++idx)
+        {
+            const Msg msg = Msg::make(idx + 1, ACTION::NEW, 1, idx + 1, SIDE::BUY, 10, 1000000);
+            std::memcpy(capture.data() + sizeof(MsgFileHeader) + idx * sizeof(Msg), &msg, sizeof(msg));
+        }
+        size_t tornBytes = 1;
+        check(MsgFileHeader::matches(capture.data(), capture.size()) && MsgFileHeader::records(capture.data(), capture.size(), tornBytes).size() == 3 && tornBytes == 0, "whole capture");
+        const std::span<const Msg> msgs = MsgFileHeader::records(capture.data(), capture.size() - 5, tornBytes);
+        check(msgs.size() == 2 && tornBytes == sizeof(Msg) - 5 && msgs[1].orderId_ == 2, "torn last record left out");
+        check(MsgFileHeader::records(capture.data(), sizeof(MsgFileHeader) + 7, tornBytes).empty() && tornBytes == 7, "lone torn record");
+        check(!MsgFileHeader::matches(capture.data(), sizeof(MsgFileHeader) - 1), "torn header");
+    }
+
+    // the dispatcher routes new orders on the product and the others through the order id, refuses an id
+    // still routed whichever shard holds it, and forgets the ids the shards report gone
+    void shardedRouting()
+    {
+        ShardedOrderBookManager manager(2, 8, false);
+        manager.configureProduct(1, ProductConfig());
+        manager.configureProduct(2, ProductConfig());
+        manager.start();
+
+        // odd ids on product 2 (shard 0), even ones on product 1 (shard 1)
+        for (int id = 1; id <= 20; ++id)
+            check(manager.submit(Msg::make(0, ACTION::NEW, 1 + id % 2, id, SIDE::BUY, 10, 990000 - id * 100)) == Result::OK, "new order routed");
+        check(manager.submit(Msg::make(0, ACTION::NEW, 2, 4, SIDE::BUY, 10, 990000)) == Result::DUPLICATE_ORDER_ID, "id live on the other shard refused");
+        check(manager.submit(Msg::make(0, ACTION::NEW, 1, 4, SIDE::BUY, 10, 990000)) == Result::DUPLICATE_ORDER_ID, "id live on the same shard refused");
+        check(manager.submit(Msg::make(0, ACTION::REMOVE, 0, 99, SIDE::BUY, 10, 990000)) == Result::UNKNOWN_ORDER_ID, "unrouted id refused");
+
+        // cancels and modifies without a product find it through the route
+        for (int id = 1; id <= 10; ++id)
+            check(manager.submit(Msg::make(0, ACTION::REMOVE, 0, id, SIDE::BUY, 10, 990000 - id * 100)) == Result::OK, "cancel routed");
+        check(manager.submit(Msg::make(0, ACTION::MODIFY, 0, 12, SIDE::BUY, 3, 990000 - 1200)) == Result::OK, "modify routed");
+        // refused by its shard, the route goes as for a cancelled order
+        check(manager.submit(Msg::make(0, ACTION::NEW, 1, 50, SIDE::BUY, 0, 990000)) == Result::OK, "new order the shard refuses");
+        manager.waitIdle();
+
+        // the routes of cancelled and refused orders are collected before a new order, their ids are free again
+        check(manager.submit(Msg::make(0, ACTION::NEW, 1, 1, SIDE::SELL, 5, 1010000)) == Result::OK, "cancelled id taken again");
+        check(manager.submit(Msg::make(0, ACTION::NEW, 2, 50, SIDE::SELL, 5, 1020000)) == Result::OK, "refused id taken again");
+        manager.stop();
+        check(manager.getRoutedOrderCount() == 12, "routes of the live orders only");
+
+        // every book on the shard of its product, holding the orders routed to it
+        const OrderBook* first = manager.getShard(1).getOrderBook(1);
+        const OrderBook* second = manager.getShard(0).getOrderBook(2);
+        check(first && second && !manager.getShard(0).getOrderBook(1) && !manager.getShard(1).getOrderBook(2), "products on their shards");
+        RestingOrder record;
+        check(first->getOrderFromId(12, record) && record.quantity_ == 3 && first->getOrderFromId(1, record) && record.side_ == SIDE::SELL, "orders on the first shard");
+        check(second->getOrderFromId(11, record) && second->getOrderFromId(50, record) && !second->getOrderFromId(4, record) && !second->getOrderFromId(3, record), "orders on the second shard");
+        check(first->getDepth().bidCount_ == 5 && second->getDepth().bidCount_ == 5, "cancelled orders gone");
+    }
+
+    // more orders gone at once than a shard can report in one go wait in its backlog, the dispatcher still
+    // forgets every one of them, trades and cancels alike
+    void shardedRetiredBacklog()
+    {
+        ShardedOrderBookManager manager(2, 2, false);
+        manager.start();
+        const int ORDERS = 200;
+        for (int id = 1; id <= ORDERS; ++id)
+            manager.submit(Msg::make(0, ACTION::NEW, 1 + id % 2, id, (id % 4 < 2) ? SIDE::BUY : SIDE::SELL, 10, 1000000));
+        // half of each book trades away, the rest is cancelled
+        manager.submit(Msg::make(0, ACTION::TRADE, 1, 0, 0, 250, 1000000));
+        manager.submit(Msg::make(0, ACTION::TRADE, 2, 0, 0, 250, 1000000));
+        for (int id = 1; id <= ORDERS; ++id)
+            manager.submit(Msg::make(0, ACTION::REMOVE, 0, id, (id % 4 < 2) ? SIDE::BUY : SIDE::SELL, 10, 1000000));
+        manager.stop();
+
+        check(manager.getRoutedOrderCount() == 0, "every finished order forgotten");
+        // the trades took 25 orders off each side of each book, only their cancels miss
+        check(manager.getRejectCount() == 100, "trades filled orders");
+        check(manager.getShard(0).getOrderBook(2)->getDepth().bidCount_ == 0 && manager.getShard(1).getOrderBook(1)->getDepth().offerCount_ == 0, "books emptied");
+    }
+
+    // levels far apart on a wide ladder, word boundaries of the occupancy bits included, emptied best first on
+    // both sides. the ladder has to find the same next best level as a sparse book holding the same orders
+    void wideLadder()
+    {
+        const Price TICK = 100;
+        const Price MIN = 100000;
+        const int TICKS = static_cast<int>(PriceBand::MAX_LADDER_TICKS) - 1;
+        const PriceBand band(TICK, MIN, MIN + (TICKS - 1) * TICK);
+        check(band.fitsLadder(), "band fits a ladder");
+
+        OrderBook ladder(1, ProductConfig(PRICE::DEFAULT_SCALE, band));
+        OrderBook sparse(2);
+        const int ticks[] = { 0, 1, 63, 64, 65, 127, 128, 4095, 4096, 4097, 20000, 65535, 65536, 100001, TICKS - 65, TICKS - 64, TICKS - 2, TICKS - 1 };
+        const int count = static_cast<int>(sizeof(ticks) / sizeof(ticks[0]));
+        // bids on the lower half of the ticks, offers on the upper half, so the book does not cross
+        for (int idx = 0; idx < count; ++idx)
+        {
+            const char side = (idx < count / 2) ? SIDE::BUY : SIDE::SELL;
+            for (OrderBook* book : { &ladder, &sparse })
+                book->enterOrder(idx + 1, side, MIN + ticks[idx] * TICK, idx + 1);
+        }
+
+        auto sameTop = [&](const char* what)
+        {
+            const DepthSnapshot a = ladder.getDepth();
+            const DepthSnapshot b = sparse.getDepth();
+            bool same = a.bidCount_ == b.bidCount_ && a.offerCount_ == b.offerCount_;
+            for (int level = 0; same && level < a.bidCount_; ++level)
+                same = a.bids_[level].price_ == b.bids_[level].price_ && a.bids_[level].quantity_ == b.bids_[level].quantity_;
+            for (int level = 0; same && level < a.offerCount_; ++level)
+                same = a.offers_[level].price_ == b.offers_[level].price_ && a.offers_[level].quantity_ == b.offers_[level].quantity_;
+            check(same, what);
+        };
+
+        sameTop("wide ladder loaded");
+        for (int idx = count / 2 - 1; idx >= 0; --idx)
+        {
+            for (OrderBook* book : { &ladder, &sparse })
+                book->deleteOrder(idx + 1);
+            sameTop("bids emptied best first");
+        }
+        for (int idx = count / 2; idx < count; ++idx)
+        {
+            for (OrderBook* book : { &ladder, &sparse })
+                book->deleteOrder(idx + 1);
+            sameTop("offers emptied best first");
+        }
+        check(ladder.getDepth().bidCount_ == 0 && ladder.getDepth().offerCount_ == 0, "wide ladder emptied");
+
+        // a lone bid entered and cancelled against an offer at the far end of the band, the ladder refinding
+        // nothing below it every time
+        ladder.enterOrder(1, SIDE::SELL, MIN + (TICKS - 1) * TICK, 1);
+        for (int round = 0; round < 1000; ++round)
+        {
+            ladder.enterOrder(2, SIDE::BUY, MIN + TICK, 1);
+            ladder.deleteOrder(2);
+        }
+        check(ladder.getDepth().bidCount_ == 0 && ladder.getDepth().offerCount_ == 1, "lone bid cycled");
+    }
+
+    // a book holding a few orders costs a few KB, the pools grow along with the book rather than by fixed slabs
+    void memoryFootprint()
+    {
+        OrderBook book(1);
+        book.enterOrder(1, SIDE::BUY, 1000000, 10);
+        book.enterOrder(2, SIDE::SELL, 1010000, 10);
+        check(book.memoryUsage().total() < 8192, "small book footprint");
+
+        for (int id = 3; id <= 1000; ++id)
+            book.enterOrder(id, SIDE::BUY, 1000000 - id % 50, 10);
+        check(book.memoryUsage().orders_ < 2 * 1000 * sizeof(Order), "order pool grows geometrically");
+
+        RestingOrder record;
+        check(book.getOrderFromId(2, record) && record.side_ == SIDE::SELL && record.price_ == 1010000, "side read back from the level link");
+        check(book.getOrderFromId(1000, record) && record.side_ == SIDE::BUY && record.price_ == 1000000 - 1000 % 50, "bid read back");
+    }
+
+    // readers on other threads look orders, depth and trades up while one thread applies a random flow with
+    // fills, cancels and modifies. whatever they read has to be a state the books can be in. make check-tsan
+    // runs it under ThreadSanitizer
+    void concurrentReaders()
+    {
+        const int IDS = 2000;
+        const int STEPS = 200000;
+        const Price MID = 1000000;
+        const Price TICK = 100;
+        const int TICKS = 50;
+
+        // one ladder book and one sparse one
+        OrderBookManager manager(IDS);
+        manager.configureProduct(1, ProductConfig(PRICE::DEFAULT_SCALE, PriceBand(TICK, MID - TICKS * TICK, MID + TICKS * TICK)));
+        manager.configureProduct(2, ProductConfig(PRICE::DEFAULT_SCALE));
+        manager.enableConcurrentReaders();
+        check(manager.action(ACTION::NEW, 3, 1, SIDE::BUY, 1, MID) == Result::UNKNOWN_PRODUCT, "no book added under concurrent readers");
+
+        std::atomic<bool> done{ false };
+        std::atomic<uint64_t> badReads{ 0 };
+
+        auto validPrice = [&](Price price) { return price >= MID - TICKS * TICK && price <= MID + TICKS * TICK && price % TICK == 0; };
+        auto reader = [&](uint64_t seed)
+        {
+            Lcg rng(seed);
+            while (!done.load(std::memory_order_acquire))
+            {
+                const int productId = rng.range(1, 2);
+                const OrderBook* book = manager.getOrderBook(productId);
+                if (!book || manager.getOrderBook(3))
+                {
+                    ++badReads;
+                    continue;
+                }
+
+                const int id = rng.range(1, IDS + 2);
+                RestingOrder record;
+                if (book->getOrderFromId(id, record))
+                {
+                    if (record.id_ != id || (record.side_ != SIDE::BUY && record.side_ != SIDE::SELL) || record.quantity_ <= 0 || !validPrice(record.price_))
+                        ++badReads;
+                }
+
+                const DepthSnapshot depth = book->getDepth();
+                for (int level = 0; level < depth.bidCount_; ++level)
+                {
+                    if (depth.bids_[level].quantity_ <= 0 || (level && depth.bids_[level].price_ >= depth.bids_[level - 1].price_))
+                        ++badReads;
+                }
+                for (int level = 0; level < depth.offerCount_; ++level)
+                {
+                    if (depth.offers_[level].quantity_ <= 0 || (level && depth.offers_[level].price_ <= depth.offers_[level - 1].price_))
+                        ++badReads;
+                }
+
+                Price price;
+                int quantity;
+                book->getLastTradeDetails(price, quantity);
+                if (price != 0 && price != MID)
+                    ++badReads;
+            }
+        };
+
+        std::vector<std::thread> readers;
+        for (uint64_t seed = 1; seed <= 2; ++seed)
+            readers.emplace_back(reader, seed);
+
+        // bids rest below MID and offers above it, a crossing pair at MID is consumed whole by the trade that follows
+        Lcg rng(42);
+        for (int step = 0; step < STEPS; ++step)
+        {
+            const int dice = rng.range(0, 99);
+            const int productId = rng.range(1, 2);
+            if (dice < 5)
+            {
+                const int qty = rng.range(1, 50);
+                manager.action(ACTION::NEW, productId, IDS + 1, SIDE::SELL, qty, MID);
+                manager.action(ACTION::NEW, productId, IDS + 2, SIDE::BUY, qty, MID);
+                manager.action(ACTION::TRADE, productId, 0, 0, qty, MID);
+                continue;
+            }
+
+            const int id = rng.range(1, IDS);
+            if (dice < 35 && manager.action(ACTION::REMOVE, 0, id, SIDE::BUY, 1, MID) == Result::OK)
+                continue;
+            if (manager.action(ACTION::MODIFY, 0, id, SIDE::BUY, rng.range(1, 100), MID) == Result::OK)
+                continue;
+
+            const bool buy = (rng.next() & 1) != 0;
+            const Price price = buy ? MID - rng.range(1, TICKS) * TICK : MID + rng.range(1, TICKS) * TICK;
+            manager.action(ACTION::NEW, productId, id, buy ? SIDE::BUY : SIDE::SELL, rng.range(1, 100), price);
+        }
+
+        done.store(true, std::memory_order_release);
+        for (auto& thread : readers)
+            thread.join();
+
+        check(badReads.load() == 0, "concurrent reads see consistent states");
+        check(manager.getRejectCount() == 1 + manager.getRejects().count(Result::UNKNOWN_ORDER_ID), "the flow only misses unknown ids");
+    }
+}
+
+int main()
+{
+    snapshotJournalRoundTrip();
+    queuePosition();
+    bulkLoadDeltas();
+    quantityChecks();
+    matching();
+    flatHashMap();
+    depthCache();
+    deltaOverrun();
+    priceParsing();
+    msgParsing();
+    shardedRouting();
+    shardedRetiredBacklog();
+    wideLadder();
+    memoryFootprint();
+    concurrentReaders();
+
+    if (failures)
+    {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}